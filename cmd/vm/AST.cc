@@ -200,7 +200,15 @@ void
 Var::generateAssignOn(CodeGen &gen, ExprNode *expr)
 {
 	expr->generateOn(gen);
+	generateStoreOn(gen);
+}
 
+/**
+ * Stores the accumulator into this variable.
+ */
+void
+Var::generateStoreOn(CodeGen &gen)
+{
 	switch (kind) {
 	case kInstance:
 		gen.genStoreInstanceVar(getIndex());
@@ -346,26 +354,20 @@ void
 PrimitiveExprNode::generateOn(CodeGen &gen)
 {
 	std::string name;
-	std::vector<RegisterID> argRegs;
-
-	if (num->oldStyle) {
-		for (auto arg : args) {
-			arg->generateOn(gen);
-			argRegs.push_back(gen.genStar());
-		}
-		return gen.genPrimitive(num->index, argRegs);
-	}
+	RegisterID mark = gen.regMark();
 
 	switch (num->kind) {
 	case Primitive::kNiladic: {
 		assert(args.size() == 0);
-		return gen.genPrimitive0(num->index);
+		gen.genPrimitive0(num->index);
+		break;
 	}
 
 	case Primitive::kMonadic: {
 		assert(args.size() == 1);
 		args[0]->generateOn(gen);
-		return gen.genPrimitive1(num->index);
+		gen.genPrimitive1(num->index);
+		break;
 	}
 
 	case Primitive::kDiadic: {
@@ -374,7 +376,8 @@ PrimitiveExprNode::generateOn(CodeGen &gen)
 		args[0]->generateOn(gen);
 		arg1reg = gen.genStar();
 		args[1]->generateOn(gen);
-		return gen.genPrimitive2(num->index, arg1reg);
+		gen.genPrimitive2(num->index, arg1reg);
+		break;
 	}
 
 	case Primitive::kTriadic: {
@@ -387,7 +390,8 @@ PrimitiveExprNode::generateOn(CodeGen &gen)
 		args[1]->generateOn(gen);
 		gen.genStar(arg2reg);
 		args[2]->generateOn(gen);
-		return gen.genPrimitive3(num->index, arg1reg);
+		gen.genPrimitive3(num->index, arg1reg);
+		break;
 	}
 
 	case Primitive::kVariadic: {
@@ -401,11 +405,14 @@ PrimitiveExprNode::generateOn(CodeGen &gen)
 			gen.genStar(argRegs[i]);
 		}
 
-		return gen.genPrimitiveV(num->index, args.size(), argRegs[0]);
+		gen.genPrimitiveV(num->index, args.size(), argRegs[0]);
+		break;
 	}
 	default:
 		abort();
 	}
+
+	gen.releaseRegs(mark);
 }
 
 void
@@ -475,9 +482,13 @@ void
 MessageExprNode::generateOn(CodeGen &gen, RegisterID recvReg, bool isSuper,
     ssize_t receiverBegin)
 {
+	/* temporaries for receiver and arguments are dead after the send */
+	RegisterID mark = gen.regMark();
+
 	if (m_specialKind != kNormal) {
 		assert(!isSuper);
-		return generateSpecialOn(gen, recvReg, receiverBegin);
+		generateSpecialOn(gen, recvReg, receiverBegin);
+		return gen.releaseRegs(mark);
 	}
 	std::vector<RegisterID> argRegs;
 
@@ -491,11 +502,12 @@ MessageExprNode::generateOn(CodeGen &gen, RegisterID recvReg, bool isSuper,
 	else if (recvReg == -1)
 		receiver->generateOn(gen);
 
-	if (!args.empty() && recvReg != -1) {
+	/* a cascade passes its receiver in a register, even to unary sends */
+	if (recvReg != -1)
 		gen.genLdar(recvReg);
-	}
 
 	gen.genMessage(isSuper, selector, argRegs);
+	gen.releaseRegs(mark);
 }
 
 void
@@ -515,6 +527,14 @@ MessageExprNode::generateSpecialOn(CodeGen &gen, RegisterID recvReg,
 			break;
 		}
 
+		case kOr: {
+			receiver->generateOn(gen);
+			auto skipSecondIfFirstTrue = gen.genBranchIfTrue();
+			args[0]->generateOn(gen);
+			gen.patchJumpToHere(skipSecondIfFirstTrue);
+			break;
+		}
+
 		case kIfFalseIfTrue:
 		case kIfTrueIfFalse: {
 			receiver->generateOn(gen);
@@ -577,6 +597,126 @@ MessageExprNode::generateSpecialOn(CodeGen &gen, RegisterID recvReg,
 			break;
 		}
 
+		case kToDo: {
+			RegisterID start, limit, counter;
+			size_t loopBegin, exit;
+
+			/* the loop's value is its start, as for Number>>to:do: */
+			m_from->generateOn(gen);
+			start = gen.genStar();
+			m_blockArg->generateStoreOn(gen);
+			m_to->generateOn(gen);
+			limit = gen.genStar();
+
+			loopBegin = gen.bytecode().size();
+			counter = m_blockArg->generateIntoReg(gen);
+			gen.genLdar(limit);
+			gen.genBinOp(counter,
+			    isOptimisedBinop(m_step > 0 ? "<=" : ">="));
+			exit = gen.genBranchIfFalse();
+
+			m_body->generateOn(gen);
+
+			counter = m_blockArg->generateIntoReg(gen);
+			gen.genLoadInteger(m_step);
+			gen.genBinOp(counter, isOptimisedBinop("+"));
+			m_blockArg->generateStoreOn(gen);
+			gen.patchJumpTo(gen.genJump(), loopBegin);
+			gen.patchJumpToHere(exit);
+			gen.genLdar(start);
+			break;
+		}
+
+		case kTimesRepeat: {
+			RegisterID limit, counter;
+			size_t loopBegin, exit;
+
+			receiver->generateOn(gen);
+			limit = gen.genStar();
+			gen.genLoadInteger(1);
+			counter = gen.genStar();
+
+			loopBegin = gen.bytecode().size();
+			gen.genLdar(limit);
+			gen.genBinOp(counter, isOptimisedBinop("<="));
+			exit = gen.genBranchIfFalse();
+
+			args[0]->generateOn(gen);
+
+			gen.genLoadInteger(1);
+			gen.genBinOp(counter, isOptimisedBinop("+"));
+			gen.genStar(counter);
+			gen.patchJumpTo(gen.genJump(), loopBegin);
+			gen.patchJumpToHere(exit);
+			gen.genLdar(limit);
+			break;
+		}
+
+		case kIsNil:
+			receiver->generateOn(gen);
+			gen.genIsNil();
+			break;
+
+		case kNotNil:
+			receiver->generateOn(gen);
+			gen.genNotNil();
+			break;
+
+		case kIdentEq:
+			recvReg = receiver->generateIntoReg(gen);
+			args[0]->generateOn(gen);
+			gen.genIdentEq(recvReg);
+			break;
+
+		case kClassOf:
+			receiver->generateOn(gen);
+			gen.genLoadClassOf();
+			break;
+
+		/* the receiver stays in the accumulator, so is the result if
+		 * the block is skipped */
+		case kIfNil: {
+			receiver->generateOn(gen);
+			size_t skip = gen.genBranchIfNotNil();
+			args[0]->generateOn(gen);
+			gen.patchJumpToHere(skip);
+			break;
+		}
+
+		case kIfNotNil: {
+			receiver->generateOn(gen);
+			size_t skip = gen.genBranchIfNil();
+			if (m_blockArg)
+				m_blockArg->generateStoreOn(gen);
+			args[0]->generateOn(gen);
+			gen.patchJumpToHere(skip);
+			break;
+		}
+
+		case kIfNilIfNotNil:
+		case kIfNotNilIfNil: {
+			ExprNode *nilBlock, *notNilBlock;
+
+			if (m_specialKind == kIfNilIfNotNil) {
+				nilBlock = args[0];
+				notNilBlock = args[1];
+			} else {
+				notNilBlock = args[0];
+				nilBlock = args[1];
+			}
+
+			receiver->generateOn(gen);
+			size_t toNil = gen.genBranchIfNil();
+			if (m_blockArg)
+				m_blockArg->generateStoreOn(gen);
+			notNilBlock->generateOn(gen);
+			size_t skipNil = gen.genJump();
+			gen.patchJumpToHere(toNil);
+			nilBlock->generateOn(gen);
+			gen.patchJumpToHere(skipNil);
+			break;
+		}
+
 		default:
 			assert(m_specialKind >= kBinOp);
 			recvReg = receiver->generateIntoReg(gen);
@@ -592,6 +732,8 @@ MessageExprNode::generateSpecialOn(CodeGen &gen, RegisterID recvReg,
 void
 CascadeExprNode::generateOn(CodeGen &gen)
 {
+	RegisterID mark = gen.regMark();
+
 	if (messages.size() == 1) {
 		receiver->generateOn(gen);
 		 messages.front()->generateOn(gen, -1,
@@ -609,6 +751,8 @@ CascadeExprNode::generateOn(CodeGen &gen)
 		     it++)
 			(*it)->generateOn(gen, rcvr, receiver->isSuper(), -1);
 	}
+
+	gen.releaseRegs(mark);
 }
 
 void
@@ -621,6 +765,10 @@ BlockExprNode::generateReturnPreludeOn(CodeGen &gen)
 void
 BlockExprNode::generateInlineOn(CodeGen &gen)
 {
+	/* an empty block answers nil */
+	if (stmts.empty())
+		gen.genLoadNil();
+
 	for (auto & s: stmts)
 		s->generateOn(gen);
 }
@@ -637,8 +785,9 @@ BlockExprNode::generateOn(CodeGen &gen)
 
 	blockGen.pushCurrentScope(scope);
 
-	for (auto &v : scope->myHeapVars)
-		v.second->generatePromoteOn(blockGen);
+	if (!scope->capturesByCopy)
+		for (auto &v : scope->myHeapVars)
+			v.second->generatePromoteOn(blockGen);
 
 	for (auto &s : stmts) {
 		s->generateOn(blockGen);
@@ -655,20 +804,33 @@ BlockExprNode::generateOn(CodeGen &gen)
 		blockGen.genReturn();
 	}
 
+	blockGen.optimise("a block");
 	block->setBytecode(ByteArrayOopDesc::fromVector(gen.omem(),
 	    blockGen.bytecode()));
 	block->setLiterals(ArrayOopDesc::fromVector(gen.omem(),
 	    blockGen.literals()));
 	block->setArgumentCount(Smi(args.size()));
 	block->setTemporarySize(Smi(scope->locals.size()));
-	block->setHeapVarsSize(Smi(scope->myHeapVars.size()));
+	block->setHeapVarsSize(Smi(scope->capturesByCopy ? 0 :
+	    scope->myHeapVars.size()));
 	block->setStackSize(Smi(blockGen.nRegs()));
 
-	// gen.popCurrentScope ();
-	// if (!blockGen._blockHasBlockReturn)
-	//    gen.genPushLiteralObject (block);
-	// else
-	gen.genLoadBlockCopy(block);
+	/*
+	 * A clean block needs none of the receiver, parent heapvars, or home
+	 * context which a block copy would fill in, so the literal itself
+	 * serves for every evaluation.
+	 */
+	if (scope->isClean)
+		gen.genLoadCleanBlock(block);
+	else if (scope->usesParentHeapVars && scope->parent()->capturesByCopy) {
+		/* captured vars are unpromoted, so these are their own regs */
+		std::vector<RegisterID> captures;
+
+		for (auto &v : scope->parent()->myHeapVars)
+			captures.push_back(v.second->generateIntoReg(gen));
+		gen.genLoadBlockCopyCapturing(block, captures);
+	} else
+		gen.genLoadBlockCopy(block);
 }
 
 #pragma mark statements
@@ -676,12 +838,18 @@ BlockExprNode::generateOn(CodeGen &gen)
 void
 ExprStmtNode::generateOn(CodeGen &gen)
 {
+	RegisterID mark = gen.regMark();
+
 	expr->generateOn(gen);
+	/* a statement's value is in the accumulator; none of its temps live */
+	gen.releaseRegs(mark);
 }
 
 void
 ReturnStmtNode::generateOn(CodeGen &gen)
 {
+	RegisterID mark = gen.regMark();
+
 	if (gen.isBlock()) {
 		/*RegisterID ret = gen.genStar();
 		gen.genLoadSelf();
@@ -695,6 +863,8 @@ ReturnStmtNode::generateOn(CodeGen &gen)
 		expr->generateOn(gen);
 		gen.genReturn();
 	}
+
+	gen.releaseRegs(mark);
 }
 
 #pragma mark decls
@@ -708,8 +878,9 @@ MethodNode::generate(ObjectMemory &omem)
 
 	gen.pushCurrentScope(scope);
 
-	for (auto &v : scope->myHeapVars)
-		v.second->generatePromoteOn(gen);
+	if (!scope->capturesByCopy)
+		for (auto &v : scope->myHeapVars)
+			v.second->generatePromoteOn(gen);
 
 	for (auto s : stmts) {
 		s->generateOn(gen);
@@ -718,12 +889,14 @@ MethodNode::generate(ObjectMemory &omem)
 			gen.genReturnSelf();
 	}
 
+	gen.optimise(sel);
 	meth->setSelector(SymbolOopDesc::fromString(omem, sel));
 	meth->setBytecode(ByteArrayOopDesc::fromVector(omem, gen.bytecode()));
 	meth->setLiterals(ArrayOopDesc::fromVector(omem, gen.literals()));
 	meth->setArgumentCount(args.size());
 	meth->setTemporarySize(scope->locals.size());
-	meth->setHeapVarsSize(scope->myHeapVars.size());
+	meth->setHeapVarsSize(scope->capturesByCopy ? 0 :
+	    scope->myHeapVars.size());
 	meth->setStackSize(gen.nRegs());
 
 #if 0
@@ -745,10 +918,18 @@ void
 ClassNode::generate(ObjectMemory &omem)
 {
 	//printf("CLASS %s/%p/%p\n", name.c_str(), cls.m_ptr, cls.isa().m_ptr);
-	for (auto m : cMethods)
-		cls->addClassMethod(omem, m->generate(omem));
-	for (auto m : iMethods)
-		cls->addMethod(omem, m->generate(omem));
+	MethodNode *cur = NULL;
+
+	/* code generation errors are attributed to their method */
+	try {
+		for (auto m : cMethods)
+			cls->addClassMethod(omem, (cur = m)->generate(omem));
+		for (auto m : iMethods)
+			cls->addMethod(omem, (cur = m)->generate(omem));
+	} catch (std::runtime_error &e) {
+		throw std::runtime_error(name + ">>" + cur->sel + ": " +
+		    e.what());
+	}
 }
 
 void
@@ -54,6 +54,9 @@ struct BlockScope;
 struct MethodScope;
 struct ClassScope;
 struct ClassNode;
+struct BlockExprNode;
+struct MessageExprNode;
+struct LocalVar;
 
 class SynthContext {
 	ObjectMemory &m_omem;
@@ -70,6 +73,7 @@ class SynthContext {
 struct Var {
 	bool promoted; /** whether this var was promoted to HeapVar */
 	int promotedIndex; /** (1-based) index into our heapvars */
+	bool assignedAfterCapture; /** whether it may change once promoted */
 
 	enum Kind {
 		kHeapVar,
@@ -90,12 +94,14 @@ struct Var {
 	    : kind(kind)
 	    , name(name)
 	    , promoted(false)
+	    , assignedAfterCapture(false)
 	{
 	}
 
 	void generateOn(CodeGen &gen);
 	RegisterID generateIntoReg(CodeGen &gen);
 	void generateAssignOn(CodeGen &gen, ExprNode *expr);
+	void generateStoreOn(CodeGen &gen);
 
 	/*
 	 * Generates code to move up this variable into myHeapVars.
@@ -177,6 +183,22 @@ struct Scope {
 
 	GlobalVar *addClass(ClassNode *aClass);
 	virtual Var *lookup(std::string aName);
+
+	/**
+	 * Notes that code in this scope refers to the receiver or to the home
+	 * method context, so that no block enclosing it can be clean.
+	 */
+	virtual void noteUsesHome() {}
+
+	/**
+	 * Notes an assignment to the variable \p aName from code in this scope
+	 * (from within a nested block if \p fromBlock). Returns whether the
+	 * variable was found.
+	 */
+	virtual bool noteAssignment(std::string aName, bool fromBlock = false)
+	{
+		return false;
+	}
 };
 
 struct ClassScope : Scope {
@@ -206,9 +228,39 @@ struct AbstractCodeScope : Scope {
 	std::vector<ArgumentVar *> args;
 	std::vector<LocalVar *> locals;
 
+	/**
+	 * Whether our heapvars are captured by copy. This is so if none of them
+	 * may be assigned once captured; they then stay in registers, no
+	 * heapvars are allocated on activation, and each block copy made here
+	 * is instead given an array of their values.
+	 */
+	bool capturesByCopy = false;
+	/** Depth of inlined loops around the code being synthesised. */
+	int loopDepth = 0;
+	/**
+	 * Locals standing in for the arguments of inlined blocks, with the
+	 * name each binds while in use; a later inlined block may reuse one of
+	 * the same name once it is free. A free one binds no name, so that the
+	 * name refers again to whatever it did outside the inlined block.
+	 */
+	std::vector<std::pair<LocalVar *, std::string>> inlinedArgs;
+	/**
+	 * Inlined sends here whose block argument a block captures. Each
+	 * evaluation of the block (each iteration of a loop) must bind its
+	 * argument afresh, which only capture by copy does; if the heapvars
+	 * are shared instead, these sends are not inlined after all.
+	 */
+	std::vector<MessageExprNode *> capturingInlines;
+
 	void addArg(std::string name);
 	void addLocal(std::string name);
+	bool mayClaimInlinedArg(std::string name);
+	LocalVar *claimInlinedArg(std::string name);
+	void releaseInlinedArg(LocalVar *var);
 	virtual Var *lookupFromBlock(std::string aName) = 0;
+	virtual MethodScope *methodScope() = 0;
+	bool noteAssignment(std::string aName, bool fromBlock = false);
+	void decideCapturesByCopy();
 };
 
 struct MethodScope : public AbstractCodeScope {
@@ -219,7 +271,14 @@ struct MethodScope : public AbstractCodeScope {
 	{
 	}
 
+	/**
+	 * Whether the method must be synthesised afresh, as some send inlined
+	 * in it cannot be after all.
+	 */
+	bool mustResynthesise = false;
+
 	ClassScope *parent() { return _parent; }
+	MethodScope *methodScope() { return this; }
 
 	virtual Var *lookup(std::string aName);
 	Var *lookupFromBlock(std::string aName);
@@ -240,6 +299,17 @@ struct BlockScope : public AbstractCodeScope {
 	 */
 
 	AbstractCodeScope *parent() { return _parent; }
+	MethodScope *methodScope() { return _parent->methodScope(); }
+
+	/**
+	 * Whether this is a clean block: one which neither refers to self nor
+	 * to its parents' variables, and contains no block return (nor do any
+	 * blocks within it.) A clean block is built once at compile time and
+	 * shared, rather than copied every time it is evaluated.
+	 */
+	bool isClean = true;
+	/** Whether this block refers to its parents' variables. */
+	bool usesParentHeapVars = false;
 
 	BlockScope(AbstractCodeScope *parent)
 	    : _parent(parent)
@@ -248,6 +318,8 @@ struct BlockScope : public AbstractCodeScope {
 
 	virtual Var *lookup(std::string aName);
 	Var *lookupFromBlock(std::string aName);
+	void noteUsesHome();
+	bool noteAssignment(std::string aName, bool fromBlock = false);
 };
 
 struct Node {
@@ -457,6 +529,12 @@ struct AssignExprNode : ExprNode {
 	}
 };
 
+/**
+ * Returns the index of \p sel among the binary operators with their own
+ * bytecode, or -1 if it is not one.
+ */
+int isOptimisedBinop(std::string sel);
+
 struct MessageExprNode : ExprNode {
 	ExprNode *receiver;
 	std::string selector;
@@ -475,9 +553,26 @@ struct MessageExprNode : ExprNode {
 		kWhileFalse0,
 		kWhileTrue,
 		kWhileFalse,
+		kToDo,
+		kTimesRepeat,
+		kIfNil,
+		kIfNotNil,
+		kIfNilIfNotNil,
+		kIfNotNilIfNil,
+		kIsNil,
+		kNotNil,
+		kIdentEq,
+		kClassOf,
 		kBinOp
 	} m_specialKind = kNormal;
 
+	/* for inlined to:do: loops and ifNotNil: */
+	ExprNode *m_from = NULL, *m_to = NULL;
+	int m_step = 1;
+	BlockExprNode *m_body = NULL;     /**< block taking an argument */
+	LocalVar *m_blockArg = NULL;      /**< local bound to that argument */
+	bool m_mayInline = true;          /**< false once that local is shared */
+
 	MessageExprNode(ExprNode *receiver, std::string selector,
 	    std::vector<ExprNode *> args = {})
 	    : receiver(receiver)
@@ -508,6 +603,12 @@ struct MessageExprNode : ExprNode {
 	void generateSpecialOn(CodeGen &gen, RegisterID receiver,
 	    ssize_t receiverBegin);
 
+    private:
+	bool synthCountingLoopInScope(Scope *scope);
+	bool synthNilTestInScope(Scope *scope);
+
+    public:
+
 	void print(int in) override
 	{
 		std::cout << blanks(in) << "<message>\n";
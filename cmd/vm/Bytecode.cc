@@ -10,11 +10,21 @@ disassemble(uint8_t *code, int length) noexcept
 
 	std::cout << "Disassembly:\n";
 
-#define FETCH code[pc++]
+/* operands are u16 after a Wide prefix */
+#define FETCH (wide ? (pc += 2, (code[pc - 2] << 8) | code[pc - 1]) : \
+    code[pc++])
 	while (pc < length) {
-		Op::Opcode op = (Op::Opcode)FETCH;
+		bool wide = false;
+		Op::Opcode op;
 
-		std::cout << pc - 1 << "\t";
+		std::cout << pc << "\t";
+
+		if (code[pc] == Op::kWide) {
+			std::cout << "wide ";
+			wide = true;
+			pc++;
+		}
+		op = (Op::Opcode)code[pc++];
 
 		switch (op) {
 		/* u8 index/reg, u8 dest */
@@ -71,8 +81,7 @@ disassemble(uint8_t *code, int length) noexcept
 
 		case Op::kLdaGlobal: {
 			unsigned src = FETCH;
-			std::cout << "ac <- ObjectMemory lookupGlobal: lit" <<
-			    src << ".\n";
+			std::cout << "ac <- (binding lit" << src << ") value.\n";
 			break;
 		}
 
@@ -95,6 +104,24 @@ disassemble(uint8_t *code, int length) noexcept
 			break;
 		}
 
+		case Op::kLdaCleanBlock: {
+			unsigned src = FETCH;
+			std::cout << "ac <- lit" << src << " (clean block).\n";
+			break;
+		}
+
+		case Op::kLdaBlockCopyCapturing: {
+			unsigned src = FETCH, nCaptures = FETCH;
+			std::cout << "ac <- lit" << src << " blockCopy capturing: [";
+			for (int i = 0; i < nCaptures; i++) {
+				if (i > 0)
+					std::cout << ",";
+				std::cout << "r" << unsigned(FETCH);
+			}
+			std::cout << "].\n";
+			break;
+		}
+
 		case Op::kLdar: {
 			unsigned src = FETCH;
 			std::cout << "ac <- r" << src << "\n";
@@ -111,8 +138,7 @@ disassemble(uint8_t *code, int length) noexcept
 
 		case Op::kStaGlobal: {
 			unsigned dst = FETCH;
-			std::cout << "ObjectMemory at: l" << dst <<
-			    " put: ac.\n";
+			std::cout << "(binding lit" << dst << ") value: ac.\n";
 			break;
 		}
 
@@ -178,6 +204,26 @@ disassemble(uint8_t *code, int length) noexcept
 			break;
 		}
 
+		/* a value, i16 pc-offset */
+		case Op::kBranchIfNil: {
+			uint8_t b1 = FETCH;
+			uint8_t b2 = FETCH;
+			int16_t offs = (b1 << 8) | b2;
+			std::cout << "ac ifNil: [self branch: " <<
+			    pc + offs << "].\n";
+			break;
+		}
+
+		/* a value, i16 pc-offset */
+		case Op::kBranchIfNotNil: {
+			uint8_t b1 = FETCH;
+			uint8_t b2 = FETCH;
+			int16_t offs = (b1 << 8) | b2;
+			std::cout << "ac ifNotNil: [self branch: " <<
+			    pc + offs << "].\n";
+			break;
+		}
+
 		case Op::kBinOp: {
 			unsigned src = FETCH;
 			unsigned op = FETCH;
@@ -187,6 +233,24 @@ disassemble(uint8_t *code, int length) noexcept
 			break;
 		}
 
+		case Op::kIdentEq: {
+			unsigned src = FETCH;
+			std::cout << "ac <- r" << src << " == ac.\n";
+			break;
+		}
+
+		case Op::kLdaClassOf:
+			std::cout << "ac <- ac class.\n";
+			break;
+
+		case Op::kIsNil:
+			std::cout << "ac <- ac isNil.\n";
+			break;
+
+		case Op::kNotNil:
+			std::cout << "ac <- ac notNil.\n";
+			break;
+
 		/**
 		 * u8 dest-reg, u8 receiver-reg, u8 selector-lit-idx,
 		 * u8 num-args, (u8 arg-reg)+
@@ -232,25 +296,6 @@ disassemble(uint8_t *code, int length) noexcept
 			break;
 		}
 
-		/** u8 prim-num, u8 num-args, (u8 arg-reg)+ */
-		case Op::kPrimitive: {
-			unsigned prim = FETCH, nArgs = FETCH;
-			std::cout << "self primitive" << prim << "";
-
-			if (nArgs > 0) {
-				std::cout << "With: [";
-				for (int i = 0; i < nArgs; i++) {
-					if (i > 0)
-						std::cout << ",";
-					std::cout << "r" << (unsigned)FETCH;
-				}
-				std::cout << "]";
-			}
-
-			std::cout << ".\n";
-			break;
-		}
-
 		/** a arg, u8 prim-num */
 		case Op::kPrimitive0: {
 			unsigned prim = FETCH;
@@ -274,11 +319,11 @@ disassemble(uint8_t *code, int length) noexcept
 			break;
 		}
 
-		/** a arg3, u8 prim-num, u8 arg1-reg, u8 arg2-reg */
+		/** a arg3, u8 prim-num, u8 arg1-reg (arg2 follows it) */
 		case Op::kPrimitive3: {
-			unsigned prim = FETCH, arg1 = FETCH, arg2 = FETCH;
+			unsigned prim = FETCH, arg1 = FETCH;
 			std::cout << "self primitive " << prim <<
-			    "With: r" << arg1 << " with:  r" << arg2 <<
+			    "With: r" << arg1 << " with:  r" << arg1 + 1 <<
 			    "with: ac.\n";
 			break;
 		}
@@ -306,6 +351,10 @@ disassemble(uint8_t *code, int length) noexcept
 			std::cout << "self blockReturn: ac.\n";
 			break;
 		}
+
+		case Op::kWide:
+			std::cout << "wide prefix to wide.\n";
+			break;
 		}
 	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <pthread.h>
 #include <ev++.h>
+#include <vector>
 
 #include "Config.hh"
 
@@ -20,8 +21,19 @@ extern "C" {
  * interpreter. One thread runs the scheduling loop; the other runs a libev
  * event loop, and communicates with the interpreter thread by setting the
  * interrupt flag.
+ *
+ * Only one pair runs. The object memory, the method caches and Semaphore's
+ * atomicity, which comes from disabling interrupts, all assume a single
+ * interpreter thread.
  */
 class CPUThreadPair : ObjectAllocator<CPUThreadPair> {
+	/** quantum in milliseconds, or 0 for the adaptive quantum */
+	static int s_timeSliceMs;
+
+	/* bounds, in seconds, of the adaptive quantum */
+	static constexpr ev::tstamp kMinQuantum = 0.005;
+	static constexpr ev::tstamp kMaxQuantum = 0.4;
+
 	volatile bool m_interruptFlag = false;	/** pending VM interrupt? */
 	bool m_otherInterruptFlag = false; /**< pending int if intr disabled? */
 	bool m_interruptsDisabled = false; /**< are interrupts disabled? */
@@ -44,6 +56,41 @@ class CPUThreadPair : ObjectAllocator<CPUThreadPair> {
 	ev::loop_ref	m_loop;		/**< The event loop. */
 	ev::async	m_loopWake;	/**< Event loop awakener. */
 	ev::timer m_timeSliceTimer;	/**< Timeslicer timer. */
+	/** is #m_timeSliceTimer running? under #m_evLock */
+	bool m_timerArmed = false;
+	ev::tstamp m_quantum = 0.1;	/**< current adaptive quantum */
+	bool m_sliceExpired = false;	/**< did the last slice run out? */
+	bool m_outrankedInSlice = false; /**< was a higher priority resumed? */
+
+	/**
+	 * A timer for the process sleeping in a SchedulerOopDesc::sleepers slot,
+	 * or for the Timer in a SchedulerOopDesc::timers slot
+	 */
+	struct SleepTimer : ev::timer {
+		size_t slot;
+
+		SleepTimer(ev::loop_ref loop, size_t slot)
+		    : ev::timer(loop), slot(slot) {};
+	};
+
+	/** I/O watchers, by SchedulerOopDesc::ioWaits slot; made as needed */
+	std::vector<ev::io *> m_ioWatchers;
+	std::vector<int> m_ioReady;	/**< slots ready; under #m_evLock */
+	/** sleep timers, by SchedulerOopDesc::sleepers slot; made as needed */
+	std::vector<SleepTimer *> m_sleepTimers;
+	std::vector<size_t> m_freeSleepSlots; /**< slots of idle sleep timers */
+	std::vector<size_t> m_sleepReady; /**< slots expired; under #m_evLock */
+	/** Timer timers, by SchedulerOopDesc::timers slot; made as needed */
+	std::vector<SleepTimer *> m_timerTimers;
+	std::vector<size_t> m_freeTimerSlots; /**< slots of idle Timer timers */
+	/** Timer slots expired, oldest first; under #m_evLock */
+	std::vector<size_t> m_timerReady;
+	/** is SchedulerOopDesc::timerService parked in #nextExpiredTimer()? */
+	bool m_timerServiceParked = false;
+	int m_nParked = 0;		/**< processes parked on I/O or timers */
+
+	/** signalled, under #m_evLock, to end waitForWork() */
+	pthread_cond_t m_idleCond;
 
 	/** Release the loop lock. Called by libev before waiting. */
 	static void loopRelease(EV_P) noexcept;
@@ -52,6 +99,13 @@ class CPUThreadPair : ObjectAllocator<CPUThreadPair> {
 	/** Entry point of the event loop thread. */
 	static void *startEvThread(void *arg);
 
+	/**
+	 * Block, having nothing to run, until an I/O or sleep event is ready.
+	 * @return false if no process is parked either, so that none ever can
+	 * be runnable again; the pair should then exit.
+	 */
+	bool waitForWork();
+
 	/**
 	 * Callback for when #m_loopWake is invoked.
 	 * If #m_wantExit is true, exits.
@@ -63,6 +117,51 @@ class CPUThreadPair : ObjectAllocator<CPUThreadPair> {
 	 */
 	void timeSliceCb(ev::timer &w, int revents);
 
+	/** The quantum for the next timeslice, in seconds. */
+	ev::tstamp quantum();
+	/**
+	 * Adjust the adaptive quantum after a timeslice: halve it if a process
+	 * outranking the running one was resumed during the slice, since
+	 * interactive processes are then waiting for the CPU; double it if the
+	 * slice ran out with none so resumed, as in a batch run. Wakeups of
+	 * processes of equal or lower priority, such as most I/O completions,
+	 * leave it be.
+	 */
+	void adaptQuantum();
+	/**
+	 * Start the timeslicer for a slice of #quantum(); or, if it is running
+	 * already, restart it if \p restart is set, else leave it be.
+	 */
+	void armTimeSlice(bool restart = true);
+	/** Stop the timeslicer, if it is running. */
+	void disarmTimeSlice();
+
+	/**
+	 * I/O watcher callback - queues the slot for #deliverEvents() and
+	 * interrupts the interpreter so that it is delivered promptly.
+	 */
+	void ioCb(ev::io &w, int revents);
+	/** Sleep timer callback - likewise, for #m_sleepReady. */
+	void sleepCb(ev::timer &w, int revents);
+	/** Timer timer callback - likewise, for #m_timerReady. */
+	void timerCb(ev::timer &w, int revents);
+	/**
+	 * Take a SleepTimer calling \p cb from \p timers, reusing an idle one
+	 * listed in \p freeSlots if there is one, and start it for \p seconds.
+	 * @return Its slot.
+	 */
+	template <void (CPUThreadPair::*cb)(ev::timer &, int)>
+	size_t startSleepTimer(std::vector<SleepTimer *> &timers,
+	    std::vector<size_t> &freeSlots, ev::tstamp seconds);
+	/**
+	 * Make the processes whose I/O is ready, or whose sleep is over,
+	 * runnable again, as Process>>receiveEvent: would; and the timer
+	 * service, if it is parked and a Timer has expired.
+	 */
+	void deliverEvents();
+	/** Grow \p array if need be so that it has an element \p index. */
+	void growToHold(ArrayOop &array, size_t index);
+
 	/** Lock the event loop. */
 	void lockLoop();
 	/** Unlock the event loop and notify it of changes. */
@@ -83,8 +182,19 @@ class CPUThreadPair : ObjectAllocator<CPUThreadPair> {
     public:
 	//static thread_local CPUThreadPair *curpair;
 
+	/**
+	 * Runs the CPU thread pair, with this thread as its interpreter thread,
+	 * until no process is left runnable or parked.
+	 */
 	CPUThreadPair(ObjectMemory &omem, void *stackMarker);
 
+	/**
+	 * Set the timeslice quantum, in milliseconds; 0 selects
+	 * the adaptive quantum. The default is 100 ms.
+	 * @return The previous setting.
+	 */
+	static int setTimeSlice(int ms);
+
 	static CPUThreadPair *curpair();
 
 	SchedulerOop scheduler() { return m_sched; };
@@ -94,6 +204,59 @@ class CPUThreadPair : ObjectAllocator<CPUThreadPair> {
 
 	/** Let the current process yield its timeslice. */
 	void yield();
+	/**
+	 * Preempt the current process because one of higher priority has
+	 * become runnable. Deferred while interrupts are disabled.
+	 */
+	void preempt();
+
+	/**
+	 * Make \p proc runnable, unless it already is, preempting the current
+	 * process if it outranks it.
+	 */
+	void resume(ProcessOop proc);
+	/** Remove \p proc from the run queue, if it is in it. */
+	void suspend(ProcessOop proc);
+	/**
+	 * Change the priority of \p proc, requeueing it if runnable and
+	 * preempting whichever process it now outranks.
+	 */
+	void setPriority(ProcessOop proc, int priority);
+
+	/**
+	 * Park \p proc, the current process, until \p fd is ready for
+	 * \p events, ev::READ or ev::WRITE. Any number of processes may wait
+	 * for the same; all are made runnable once it is ready, to retry.
+	 */
+	void awaitIO(ProcessOop proc, int fd, int events);
+	/**
+	 * Park \p proc, the current process, for \p seconds. Sleeping costs
+	 * a libev timer, which libev keeps in a heap, and no CPU.
+	 */
+	void sleep(ProcessOop proc, ev::tstamp seconds);
+	/**
+	 * Arm a timer to expire \p timer after \p seconds. It costs a libev
+	 * timer, but no process: SchedulerOopDesc::timerService, one process
+	 * for all Timers, collects expired Timers by #nextExpiredTimer().
+	 * @return The slot of \p timer in SchedulerOopDesc::timers.
+	 */
+	size_t startTimer(Oop timer, ev::tstamp seconds);
+	/**
+	 * Disarm \p timer, which #startTimer() put in \p slot.
+	 * @return false if it has already been collected, or was never armed.
+	 */
+	bool cancelTimer(Oop timer, size_t slot);
+	/**
+	 * Take the Timer which expired the earliest and has not been collected.
+	 * If there is none, park \p proc, the current process, until there is.
+	 * @return The Timer, or nil if \p proc has been parked.
+	 */
+	Oop nextExpiredTimer(ProcessOop proc);
+	/**
+	 * Stop watching \p fd, which is being closed. The processes parked on
+	 * it are made runnable, to find it closed.
+	 */
+	void cancelIO(int fd);
 
 };
 
@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
 #include "Generation.hh"
 #include "Interpreter.hh"
+#include "ObjectMemory.hh"
 #include "Objects.hh"
 
 void
@@ -14,28 +19,47 @@ CodeGen::gen(Op::Opcode code)
 	genCode(code);
 }
 
+/**
+ * Generates an instruction with operands. These are ordinarily u8; if any
+ * exceeds that, the instruction is prefixed by Wide and all its operands
+ * are u16 instead.
+ */
 void
-CodeGen::gen(Op::Opcode code, uint8_t arg1)
+CodeGen::gen(Op::Opcode code, std::vector<unsigned> operands)
 {
+	bool wide = std::any_of(operands.begin(), operands.end(),
+	    [](unsigned operand) { return operand > UINT8_MAX; });
+
+	if (wide)
+		genCode(Op::kWide);
 	genCode(code);
-	genCode(arg1);
+
+	for (auto operand : operands) {
+		if (operand > UINT16_MAX)
+			throw std::runtime_error("Bytecode operand " +
+			    std::to_string(operand) + " too large");
+		if (wide)
+			genCode(operand >> 8);
+		genCode(operand & 0xff);
+	}
 }
 
 void
-CodeGen::gen(Op::Opcode code, uint8_t arg1, uint8_t arg2)
+CodeGen::gen(Op::Opcode code, unsigned arg1)
 {
-	genCode(code);
-	genCode(arg1);
-	genCode(arg2);
+	gen(code, std::vector<unsigned> { arg1 });
 }
 
 void
-CodeGen::gen(Op::Opcode code, uint8_t arg1, uint8_t arg2, uint8_t arg3)
+CodeGen::gen(Op::Opcode code, unsigned arg1, unsigned arg2)
 {
-	genCode(code);
-	genCode(arg1);
-	genCode(arg2);
-	genCode(arg3);
+	gen(code, std::vector<unsigned> { arg1, arg2 });
+}
+
+void
+CodeGen::gen(Op::Opcode code, unsigned arg1, unsigned arg2, unsigned arg3)
+{
+	gen(code, std::vector<unsigned> { arg1, arg2, arg3 });
 }
 
 int
@@ -54,32 +78,32 @@ CodeGen::addSym(std::string str)
 RegisterID
 CodeGen::allocReg()
 {
+	m_maxReg = std::max(m_maxReg, m_reg + 1);
 	return m_reg++;
 }
 
 void
-CodeGen::genMoveParentHeapVarToMyHeapVars(uint8_t index, uint8_t promotedIndex)
+CodeGen::genMoveParentHeapVarToMyHeapVars(unsigned index, unsigned promotedIndex)
 {
-	gen(Op::kMoveParentHeapVarToMyHeapVars, index);
-	genCode(promotedIndex);
+	gen(Op::kMoveParentHeapVarToMyHeapVars, index, promotedIndex);
 }
 
 void
-CodeGen::genMoveArgumentToMyHeapVars(uint8_t index, uint8_t promotedIndex)
+CodeGen::genMoveArgumentToMyHeapVars(unsigned index, unsigned promotedIndex)
 {
 	gen(Op::kLdar, index);
 	gen(Op::kStaMyHeapVar, promotedIndex);
 }
 
 void
-CodeGen::genMoveLocalToMyHeapVars(uint8_t index, uint8_t promotedIndex)
+CodeGen::genMoveLocalToMyHeapVars(unsigned index, unsigned promotedIndex)
 {
 	gen(Op::kLdar, localIndex(index));
 	gen(Op::kStaMyHeapVar, promotedIndex);
 }
 
 void
-CodeGen::genMoveMyHeapVarToParentHeapVars(uint8_t myIndex, uint8_t parentIndex)
+CodeGen::genMoveMyHeapVarToParentHeapVars(unsigned myIndex, unsigned parentIndex)
 {
 	gen(Op::kMoveMyHeapVarToParentHeapVars, myIndex, parentIndex);
 }
@@ -91,7 +115,7 @@ CodeGen::genLdar(RegisterID reg)
 }
 
 void
-CodeGen::genLoadArgument(uint8_t index)
+CodeGen::genLoadArgument(unsigned index)
 {
 	genLdar(index); /* arg index is 1-based addressing */
 }
@@ -99,29 +123,30 @@ CodeGen::genLoadArgument(uint8_t index)
 void
 CodeGen::genLoadGlobal(std::string name)
 {
-	gen(Op::kLdaGlobal, addSym(name));
+	gen(Op::kLdaGlobal, addLit(m_omem.globalBinding(
+	    SymbolOopDesc::fromString(m_omem, name))));
 }
 
 void
-CodeGen::genLoadInstanceVar(uint8_t index)
+CodeGen::genLoadInstanceVar(unsigned index)
 {
 	gen(Op::kLdaNstVar, index);
 }
 
 void
-CodeGen::genLoadLocal(uint8_t index)
+CodeGen::genLoadLocal(unsigned index)
 {
 	genLdar(localIndex(index));
 }
 
 void
-CodeGen::genLoadParentHeapVar(uint8_t index)
+CodeGen::genLoadParentHeapVar(unsigned index)
 {
 	gen(Op::kLdaParentHeapVar, index);
 }
 
 void
-CodeGen::genLoadMyHeapVar(uint8_t index)
+CodeGen::genLoadMyHeapVar(unsigned index)
 {
 	gen(Op::kLdaMyHeapVar, index);
 }
@@ -169,7 +194,7 @@ CodeGen::genLoadThisProcess()
 }
 
 void
-CodeGen::genLoadLiteral(uint8_t num)
+CodeGen::genLoadLiteral(unsigned num)
 {
 	gen(Op::kLdaLiteral,num);
 }
@@ -192,10 +217,27 @@ CodeGen::genLoadBlockCopy(BlockOop block)
 	gen(Op::kLdaBlockCopy, addLit(block));
 }
 
+void
+CodeGen::genLoadCleanBlock(BlockOop block)
+{
+	gen(Op::kLdaCleanBlock, addLit(block));
+}
+
+void
+CodeGen::genLoadBlockCopyCapturing(BlockOop block,
+    std::vector<RegisterID> captures)
+{
+	std::vector<unsigned> operands = { unsigned(addLit(block)),
+	    unsigned(captures.size()) };
+
+	operands.insert(operands.end(), captures.begin(), captures.end());
+	gen(Op::kLdaBlockCopyCapturing, operands);
+}
+
 RegisterID
 CodeGen::genStar()
 {
-	RegisterID reg = m_reg++;
+	RegisterID reg = allocReg();
 	gen(Op::kStar, reg);
 	return reg;
 }
@@ -209,7 +251,7 @@ CodeGen::genStar(RegisterID into)
 
 
 void
-CodeGen::genStoreInstanceVar(uint8_t index)
+CodeGen::genStoreInstanceVar(unsigned index)
 {
 	gen(Op::kStaNstVar, index);
 }
@@ -217,30 +259,40 @@ CodeGen::genStoreInstanceVar(uint8_t index)
 void
 CodeGen::genStoreGlobal(std::string name)
 {
-	gen(Op::kStaGlobal, addSym(name));
+	gen(Op::kStaGlobal, addLit(m_omem.globalBinding(
+	    SymbolOopDesc::fromString(m_omem, name))));
 }
 
 void
-CodeGen::genStoreLocal(uint8_t index)
+CodeGen::genStoreLocal(unsigned index)
 {
 	gen(Op::kStar, localIndex(index));
 }
 
 void
-CodeGen::genStoreParentHeapVar(uint8_t index)
+CodeGen::genStoreParentHeapVar(unsigned index)
 {
 	gen(Op::kStaParentHeapVar, index);
 }
 
 void
-CodeGen::genStoreMyHeapVar(uint8_t index)
+CodeGen::genStoreMyHeapVar(unsigned index)
 {
 	gen(Op::kStaMyHeapVar, index);
 }
 
+/**
+ * Encodes a jump offset. Jumps are not widened, so a method whose code spans
+ * more than an i16 is refused rather than miscompiled.
+ */
 void
-i16tou8(int16_t i16, uint8_t out[2])
+i16tou8(ssize_t offs, uint8_t out[2])
 {
+	int16_t i16 = offs;
+
+	if (i16 != offs)
+		throw std::runtime_error("Jump of " + std::to_string(offs) +
+		    " bytes too long for bytecode");
 	out [0] = ((i16 & 0xFF00) >> 8);
 	out [1] = (i16 & 0x00FF);
 }
@@ -265,11 +317,26 @@ CodeGen::genBranchIfTrue()
 	return m_bytecode.size();
 }
 
+size_t
+CodeGen::genBranchIfNil()
+{
+	gen(Op::kBranchIfNil, 0, 0);
+	return m_bytecode.size();
+}
+
+size_t
+CodeGen::genBranchIfNotNil()
+{
+	gen(Op::kBranchIfNotNil, 0, 0);
+	return m_bytecode.size();
+}
+
 void
 CodeGen::patchJumpToHere(size_t jumpInstrLoc)
 {
 	uint8_t relative[2];
-	i16tou8(m_bytecode.size() - jumpInstrLoc, relative);
+	i16tou8(ssize_t(m_bytecode.size()) - ssize_t(jumpInstrLoc),
+	    relative);
 	m_bytecode[jumpInstrLoc - 1] = relative[1];
 	m_bytecode[jumpInstrLoc - 2] = relative[0];
 }
@@ -278,71 +345,82 @@ void
 CodeGen::patchJumpTo(size_t jumpInstrLoc, size_t loc)
 {
 	uint8_t relative[2];
-	i16tou8(loc - jumpInstrLoc, relative);
+	i16tou8(ssize_t(loc) - ssize_t(jumpInstrLoc), relative);
 	m_bytecode[jumpInstrLoc - 1] = relative[1];
 	m_bytecode[jumpInstrLoc - 2] = relative[0];
 }
 
 void
-CodeGen::genBinOp(uint8_t arg, uint8_t op)
+CodeGen::genBinOp(unsigned arg, uint8_t op)
 {
 	gen(Op::kBinOp, arg, op);
 }
 
 void
-CodeGen::genMessage(bool isSuper, std::string selector,
-    std::vector<RegisterID> args)
+CodeGen::genIdentEq(RegisterID arg)
 {
-	CacheOop cache = CacheOopDesc::newWithSelector(m_omem,
-	    SymbolOopDesc::fromString(m_omem, selector));
+	gen(Op::kIdentEq, arg);
+}
 
-	if (isSuper)
-		gen(Op::kSendSuper, addLit(cache), args.size());
-	else
-		gen(Op::kSend, addLit(cache), args.size());
+void
+CodeGen::genLoadClassOf()
+{
+	gen(Op::kLdaClassOf);
+}
 
-	for (auto arg: args)
-		genCode(arg);
+void
+CodeGen::genIsNil()
+{
+	gen(Op::kIsNil);
 }
 
 void
-CodeGen::genPrimitive(uint8_t primNum, std::vector<RegisterID> args)
+CodeGen::genNotNil()
 {
-	gen(Op::kPrimitive, primNum, args.size());
+	gen(Op::kNotNil);
+}
+
+void
+CodeGen::genMessage(bool isSuper, std::string selector,
+    std::vector<RegisterID> args)
+{
+	CacheOop cache = CacheOopDesc::newWithSelector(m_omem,
+	    SymbolOopDesc::fromString(m_omem, selector));
+	std::vector<unsigned> operands = { unsigned(addLit(cache)),
+	    unsigned(args.size()) };
 
-	for (auto arg: args)
-		genCode(arg);
+	operands.insert(operands.end(), args.begin(), args.end());
+	gen(isSuper ? Op::kSendSuper : Op::kSend, operands);
 }
 
 void
-CodeGen::genPrimitive0(uint8_t primNum)
+CodeGen::genPrimitive0(unsigned primNum)
 {
 	gen(Op::kPrimitive0, primNum);
 }
 
 void
-CodeGen::genPrimitive1(uint8_t primNum)
+CodeGen::genPrimitive1(unsigned primNum)
 {
 	gen(Op::kPrimitive1, primNum);
 }
 
 void
-CodeGen::genPrimitive2(uint8_t primNum, RegisterID arg1reg)
+CodeGen::genPrimitive2(unsigned primNum, RegisterID arg1reg)
 {
 	gen(Op::kPrimitive2, primNum, arg1reg);
 }
 
 void
-CodeGen::genPrimitive3(uint8_t primNum, RegisterID arg1reg)
+CodeGen::genPrimitive3(unsigned primNum, RegisterID arg1reg)
 {
 	gen(Op::kPrimitive3, primNum, arg1reg);
 }
 
 void
-CodeGen::genPrimitiveV(uint8_t primNum, uint8_t nArgs, RegisterID arg1reg)
+CodeGen::genPrimitiveV(unsigned primNum, unsigned nArgs, RegisterID arg1reg)
 {
-	gen(Op::kPrimitiveV, primNum, nArgs);
-	genCode(arg1reg);
+	gen(Op::kPrimitiveV, primNum, nArgs, arg1reg);
 }
 
 
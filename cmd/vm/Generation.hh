@@ -18,20 +18,30 @@ class CodeGen {
 	bool m_isBlock;
 	bool m_hasOwnBlockReturn;
 
+	/*
+	 * Temporaries live only until the expression or statement which
+	 * allocated them is done, so their lifetimes nest: m_reg is the next
+	 * free register, and m_maxReg the most ever in use, i.e. the frame size.
+	 */
 	RegisterID m_reg;
+	RegisterID m_maxReg;
 	int m_nArgs;
 	int m_nLocals;
 
 	void genCode(uint8_t code);
 	void gen (Op::Opcode code);
-	void gen (Op::Opcode code, uint8_t arg1);
-	void gen (Op::Opcode code, uint8_t arg1, uint8_t arg2);
-	void gen (Op::Opcode code, uint8_t arg1, uint8_t arg2, uint8_t arg3);
+	void gen (Op::Opcode code, std::vector<unsigned> operands);
+	void gen (Op::Opcode code, unsigned arg1);
+	void gen (Op::Opcode code, unsigned arg1, unsigned arg2);
+	void gen (Op::Opcode code, unsigned arg1, unsigned arg2, unsigned arg3);
 
 	int addLit(Oop oop);
 	int addSym(std::string str);
 
     public:
+	/** whether to print bytecode before and after optimisation */
+	static bool dumpBytecode;
+
 	CodeGen(ObjectMemory &omem, int nArgs, int nLocals,
 	    bool isBlock = false)
 	    : m_omem(omem)
@@ -39,6 +49,7 @@ class CodeGen {
 	    , m_nArgs(nArgs)
 	    , m_nLocals(nLocals)
 	    , m_reg (nArgs + nLocals + 1)
+	    , m_maxReg (m_reg)
 	{
 	}
 
@@ -47,7 +58,7 @@ class CodeGen {
 	ObjectMemory & omem() { return m_omem; }
 	std::vector<uint8_t> bytecode() { return m_bytecode; }
 	std::vector<Oop> literals() { return m_literals; }
-	size_t nRegs() { return m_reg; }
+	size_t nRegs() { return m_maxReg; }
 
 	bool isBlock() { return m_isBlock; }
 	bool hasOwnBlockReturn() { return m_hasOwnBlockReturn; }
@@ -57,21 +68,26 @@ class CodeGen {
 	void popCurrentScope() { m_scope.pop(); }
 
 	RegisterID allocReg();
-
-	void genMoveParentHeapVarToMyHeapVars(uint8_t index,
-	    uint8_t promotedIndex);
-	void genMoveArgumentToMyHeapVars(uint8_t index, uint8_t promotedIndex);
-	void genMoveLocalToMyHeapVars(uint8_t index, uint8_t promotedIndex);
-	void genMoveMyHeapVarToParentHeapVars(uint8_t myIndex,
-	    uint8_t parentIndex);
+	void optimise(std::string name);
+	/** Returns a mark to later free temporaries allocated after it. */
+	RegisterID regMark() { return m_reg; }
+	/** Frees the temporaries allocated since \p mark was taken. */
+	void releaseRegs(RegisterID mark) { m_reg = mark; }
+
+	void genMoveParentHeapVarToMyHeapVars(unsigned index,
+	    unsigned promotedIndex);
+	void genMoveArgumentToMyHeapVars(unsigned index, unsigned promotedIndex);
+	void genMoveLocalToMyHeapVars(unsigned index, unsigned promotedIndex);
+	void genMoveMyHeapVarToParentHeapVars(unsigned myIndex,
+	    unsigned parentIndex);
 
 	void genLdar(RegisterID reg);
-	void genLoadArgument(uint8_t index);
+	void genLoadArgument(unsigned index);
 	void genLoadGlobal(std::string name);
-	void genLoadInstanceVar(uint8_t index);
-	void genLoadLocal(uint8_t index);
-	void genLoadParentHeapVar(uint8_t index);
-	void genLoadMyHeapVar(uint8_t index);
+	void genLoadInstanceVar(unsigned index);
+	void genLoadLocal(unsigned index);
+	void genLoadParentHeapVar(unsigned index);
+	void genLoadMyHeapVar(unsigned index);
 	void genLoadSelf();
 	void genLoadNil();
 	void genLoadTrue();
@@ -79,35 +95,43 @@ class CodeGen {
 	void genLoadSmalltalk();
 	void genLoadThisContext();
 	void genLoadThisProcess();
-	void genLoadLiteral(uint8_t num);
+	void genLoadLiteral(unsigned num);
 	void genLoadLiteralObject(Oop anObj);
 	void genLoadInteger(int val);
 	void genLoadBlockCopy(BlockOop block);
+	void genLoadCleanBlock(BlockOop block);
+	void genLoadBlockCopyCapturing(BlockOop block,
+	    std::vector<RegisterID> captures);
 
 	RegisterID genStar();
 	RegisterID genStar(RegisterID into);
-	void genStoreInstanceVar (uint8_t index);
+	void genStoreInstanceVar (unsigned index);
 	void genStoreGlobal (std::string name);
-	void genStoreLocal (uint8_t index);
-	void genStoreParentHeapVar (uint8_t index);
-	void genStoreMyHeapVar (uint8_t index);
+	void genStoreLocal (unsigned index);
+	void genStoreParentHeapVar (unsigned index);
+	void genStoreMyHeapVar (unsigned index);
 
 	size_t genJump();
 	size_t genBranchIfFalse();
 	size_t genBranchIfTrue();
+	size_t genBranchIfNil();
+	size_t genBranchIfNotNil();
 	void patchJumpToHere(size_t jumpInstrLoc);
 	void patchJumpTo(size_t jumpInstrLoc, size_t loc);
 
-	void genBinOp(uint8_t arg, uint8_t op);
+	void genBinOp(unsigned arg, uint8_t op);
+	void genIdentEq(RegisterID arg);
+	void genLoadClassOf();
+	void genIsNil();
+	void genNotNil();
 
 	void genMessage(bool isSuper,std::string selector,
 	    std::vector<RegisterID> args);
-	void genPrimitive(uint8_t primNum, std::vector<RegisterID> args);
-	void genPrimitive0(uint8_t primNum);
-	void genPrimitive1(uint8_t primNum);
-	void genPrimitive2(uint8_t primNum, RegisterID arg1reg);
-	void genPrimitive3(uint8_t primNum, RegisterID arg1reg);
-	void genPrimitiveV(uint8_t primNum, uint8_t nArgs, RegisterID arg1reg);
+	void genPrimitive0(unsigned primNum);
+	void genPrimitive1(unsigned primNum);
+	void genPrimitive2(unsigned primNum, RegisterID arg1reg);
+	void genPrimitive3(unsigned primNum, RegisterID arg1reg);
+	void genPrimitiveV(unsigned primNum, unsigned nArgs, RegisterID arg1reg);
 
 	void genReturn();
 	void genReturnSelf();
@@ -117,6 +117,9 @@ lookupMethod(Oop receiver, ClassOop startCls, SymbolOop selector)
 }
 
 #define FETCH() (*pc++)
+#define FETCH16() (pc += 2, (pc[-2] << 8) | pc[-1])
+/* an argument register of a Send or LdaBlockCopyCapturing */
+#define FETCHREG() (wideRegs ? FETCH16() : FETCH())
 
 #define CTX proc->context()
 #define HEAPVAR(x) CTX->heapVars->basicAt(x)
@@ -259,8 +262,12 @@ void currentMethod(ProcessOop proc, ContextOop ctx)
 	if (ctx->isBlockContext())
 	{
 		std::cout << "<block>(";
-		std::cout << proc->contextAt(ctx->block()->homeMethodContext().smi())->
-		    method()->selector()->asCStr() << ")";
+		if (ctx->homeMethodBP.isNil())
+			std::cout << "clean";
+		else
+			std::cout << proc->contextAt(ctx->homeMethodBP.smi())->
+			    method()->selector()->asCStr();
+		std::cout << ")";
 	}
 	else
 		 std::cout << "" << ctx->method()->selector()->asCStr();
@@ -291,6 +298,15 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		OPS
 #undef X
 	};
+	/* handlers for instructions prefixed by Wide */
+	static void* wideTable[] = {
+#define X(OP) &&wide##OP,
+		OPS
+#undef X
+	};
+	/* operands, fetched before joining the body of a handler */
+	unsigned opnd1, opnd2, opnd3;
+	bool wideRegs = false;
 	uint64_t in = 0, maxin = 0;
 	uint64_t nsends = 0;
 	Oop ac;
@@ -315,14 +331,20 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 	loop:
 	DISPATCH();
 	/* u8 index/reg, u8 dest */
-	opMoveParentHeapVarToMyHeapVars : {
-		unsigned src = FETCH(), dst = FETCH();
+	opMoveParentHeapVarToMyHeapVars :
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodyMoveParentHeapVarToMyHeapVars : {
+		unsigned src = opnd1, dst = opnd2;
 		HEAPVAR(dst) = PARENTHEAPVAR(src);
 		DISPATCH();
 	}
 
-	opMoveMyHeapVarToParentHeapVars : {
-		unsigned src = FETCH(), dst = FETCH();
+	opMoveMyHeapVarToParentHeapVars :
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodyMoveMyHeapVarToParentHeapVars : {
+		unsigned src = opnd1, dst = opnd2;
 		PARENTHEAPVAR(dst) = HEAPVAR(src);
 		DISPATCH();
 	}
@@ -357,39 +379,59 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		DISPATCH();
 
 	/* u8 index*/
-	opLdaParentHeapVar : {
-		unsigned src = FETCH();
+	opLdaParentHeapVar :
+		opnd1 = FETCH();
+	bodyLdaParentHeapVar : {
+		unsigned src = opnd1;
 		ac = PARENTHEAPVAR(src);
 		DISPATCH();
 	}
 
-	opLdaMyHeapVar : {
-		unsigned src = FETCH();
+	opLdaMyHeapVar :
+		opnd1 = FETCH();
+	bodyLdaMyHeapVar : {
+		unsigned src = opnd1;
 		ac = HEAPVAR(src);
 		DISPATCH();
 	}
 
-	opLdaGlobal : {
-		unsigned src = FETCH();
-		SymbolOop name = lits[src].as<SymbolOop>();
-		ac = omem.objGlobals->symbolLookup(name);
+	opLdaGlobal :
+		opnd1 = FETCH();
+	bodyLdaGlobal : {
+		unsigned src = opnd1;
+		ac = lits[src].as<AssociationLinkOop>()->two();
 		DISPATCH();
 	}
 
-	opLdaNstVar : {
-		unsigned src = FETCH();
+	opLdaNstVar :
+		opnd1 = FETCH();
+	bodyLdaNstVar : {
+		unsigned src = opnd1;
 		ac = NSTVAR(src);
 		DISPATCH();
 	}
 
-	opLdaLiteral : {
-		unsigned src = FETCH();
+	opLdaLiteral :
+		opnd1 = FETCH();
+	bodyLdaLiteral : {
+		unsigned src = opnd1;
 		ac = lits[src];
 		DISPATCH();
 	}
 
-	opLdaBlockCopy : {
-		unsigned src = FETCH();
+	opLdaCleanBlock :
+		opnd1 = FETCH();
+	bodyLdaCleanBlock : {
+		/* a clean block is shared; there is nothing to fill in */
+		unsigned src = opnd1;
+		ac = lits[src];
+		DISPATCH();
+	}
+
+	opLdaBlockCopy :
+		opnd1 = FETCH();
+	bodyLdaBlockCopy : {
+		unsigned src = opnd1;
 		volatile MemOop constructor = lits[src].as<MemOop>();
 		BlockOop block;
 
@@ -422,53 +464,101 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		DISPATCH();
 	}
 
-	opLdar : {
-		unsigned src = FETCH();
+	opLdaBlockCopyCapturing :
+		wideRegs = false;
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodyLdaBlockCopyCapturing : {
+		unsigned src = opnd1;
+		unsigned nCaptures = opnd2;
+		volatile MemOop constructor = lits[src].as<MemOop>();
+		BlockOop block;
+		ArrayOop captures;
+
+		/*
+		 * the creating scope keeps its captured variables in registers
+		 * as they never change once captured; so the block is given an
+		 * array of their values in place of our (nonexistent) heapvars.
+		 */
+		block = omem.copyObj<BlockOop>(constructor.m_ptr);
+		captures = ArrayOopDesc::newWithSize(omem, nCaptures);
+		for (unsigned i = 1; i <= nCaptures; i++)
+			captures->basicAt(i) = CTX->regAt0(FETCHREG());
+		block->parentHeapVars() = captures;
+		block->receiver() = RECEIVER;
+		block->homeMethodContext() = CTX->isBlockContext() ?
+		    CTX->homeMethodBP : proc->bp;
+		ac = block;
+
+		DISPATCH();
+	}
+
+	opLdar :
+		opnd1 = FETCH();
+	bodyLdar : {
+		unsigned src = opnd1;
 		ac = CTX->regAt0(src);
 		DISPATCH();
 	}
 
 	/* u8 index */
-	opStaNstVar : {
-		unsigned dst = FETCH();
+	opStaNstVar :
+		opnd1 = FETCH();
+	bodyStaNstVar : {
+		unsigned dst = opnd1;
 		NSTVAR(dst) = ac;
 		DISPATCH();
 	}
 
-	opStaGlobal : {
-		unsigned dst = FETCH();
-		printf("UNIMPLEMENTED StaGlobal\n");
-		abort();
+	opStaGlobal :
+		opnd1 = FETCH();
+	bodyStaGlobal : {
+		unsigned dst = opnd1;
+		AssociationLinkOop binding = lits[dst].as<AssociationLinkOop>();
+		/* defining it in the globals also updates the binding */
+		omem.objGlobals->symbolInsert(omem,
+		    binding->one().as<SymbolOop>(), ac);
 		DISPATCH();
 	}
 
-	opStaParentHeapVar : {
-		unsigned dst = FETCH();
+	opStaParentHeapVar :
+		opnd1 = FETCH();
+	bodyStaParentHeapVar : {
+		unsigned dst = opnd1;
 		PARENTHEAPVAR(dst) = ac;
 		DISPATCH();
 	}
 
-	opStaMyHeapVar : {
-		unsigned dst = FETCH();
+	opStaMyHeapVar :
+		opnd1 = FETCH();
+	bodyStaMyHeapVar : {
+		unsigned dst = opnd1;
 		HEAPVAR(dst) = ac;
 		DISPATCH();
 	}
 
-	opStar : {
-		unsigned dst = FETCH();
+	opStar :
+		opnd1 = FETCH();
+	bodyStar : {
+		unsigned dst = opnd1;
 		CTX->regAt0(dst) = ac;
 		DISPATCH();
 	}
 
-	opMove : {
-		unsigned dst = FETCH(), src = FETCH();
+	opMove :
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodyMove : {
+		unsigned dst = opnd1, src = opnd2;
 		CTX->regAt0(dst) = CTX->regAt0(src);
 		DISPATCH();
 	}
 
 	/* ac value, u8 src-reg */
-	opAnd : {
-		unsigned src = FETCH();
+	opAnd :
+		opnd1 = FETCH();
+	bodyAnd : {
+		unsigned src = opnd1;
 		if (ac != ObjectMemory::objTrue ||
 		    CTX->regAt0(src) != ObjectMemory::objTrue)
 			ac = ObjectMemory::objFalse;
@@ -510,10 +600,34 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		DISPATCH();
 	}
 
-	opBinOp : {
+	/* a value, i16 pc-offset */
+	opBranchIfNil : {
+		TESTCOUNTER();
+		uint8_t b1 = FETCH();
+		uint8_t b2 = FETCH();
+		int16_t offs = (b1 << 8) | b2;
+		if (ac.isNil())
+			pc = pc + offs;
+		DISPATCH();
+	}
+
+	/* a value, i16 pc-offset */
+	opBranchIfNotNil : {
 		TESTCOUNTER();
-		uint8_t src = FETCH();
-		uint8_t op = FETCH();
+		uint8_t b1 = FETCH();
+		uint8_t b2 = FETCH();
+		int16_t offs = (b1 << 8) | b2;
+		if (!ac.isNil())
+			pc = pc + offs;
+		DISPATCH();
+	}
+
+	opBinOp :
+		TESTCOUNTER();
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodyBinOp : {
+		unsigned src = opnd1, op = opnd2;
 		Oop arg1 = CTX->regAt0(src);
 		Oop arg2 = ac;
 
@@ -538,13 +652,56 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		DISPATCH();
 	}
 
+	/*
+	 * The intrinsics. Nothing overrides these messages but Character>>==,
+	 * which compares Characters by value; IdentEq does likewise.
+	 */
+
+	/** a arg, u8 receiver-reg, ->a whether identical */
+	opIdentEq :
+		TESTCOUNTER();
+		opnd1 = FETCH();
+	bodyIdentEq : {
+		unsigned src = opnd1;
+		Oop rcvr = CTX->regAt0(src);
+		bool ident = rcvr == ac ||
+		    (rcvr.isa() == ObjectMemory::clsCharacter &&
+			ac.isa() == ObjectMemory::clsCharacter &&
+			rcvr.as<CharOop>()->value() == ac.as<CharOop>()->value());
+
+		ac = ident ? ObjectMemory::objTrue : ObjectMemory::objFalse;
+		DISPATCH();
+	}
+
+	/** a receiver, ->a its class */
+	opLdaClassOf :
+		TESTCOUNTER();
+		ac = ac.isa();
+		DISPATCH();
+
+	/** a receiver, ->a whether nil */
+	opIsNil :
+		TESTCOUNTER();
+		ac = ac.isNil() ? ObjectMemory::objTrue : ObjectMemory::objFalse;
+		DISPATCH();
+
+	/** a receiver, ->a whether not nil */
+	opNotNil :
+		TESTCOUNTER();
+		ac = ac.isNil() ? ObjectMemory::objFalse : ObjectMemory::objTrue;
+		DISPATCH();
+
 	/**
 	 * a receiver, u8 selector-literal-index, u8 num-args,
 	 *     (u8 arg-register)+, ->a result
 	 */
-	opSend : {
+	opSend :
 		TESTCOUNTER();
-		unsigned selIdx = FETCH(), nArgs = FETCH();
+		wideRegs = false;
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodySend : {
+		unsigned selIdx = opnd1, nArgs = opnd2;
 		CacheOop cache = lits[selIdx].as<CacheOop>();
 		assert(ac.isNil() || ac.isSmi() || ac.as<MemOop>()->m_kind != MemOopDesc::kFwd);
 		ClassOop cls = ac.isa();
@@ -559,7 +716,7 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		assert(meth->m_kind != MemOopDesc::kFwd);
 		newCtx->initWithMethod(omem, ac, meth);
 		for (int i = 0; i < nArgs; i++)
-			newCtx->regAt0(i + 1) = CTX->regAt0(FETCH());
+			newCtx->regAt0(i + 1) = CTX->regAt0(FETCHREG());
 
 		SPILL();
 		proc->bp = newBP;
@@ -577,9 +734,13 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 	 * a receiver, u8 selector-literal-index, u8 num-args,
 	 *     (u8 arg-register)+, ->a result
 	 */
-	opSendSuper : {
+	opSendSuper :
 		TESTCOUNTER();
-		unsigned selIdx = FETCH(), nArgs = FETCH();
+		wideRegs = false;
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodySendSuper : {
+		unsigned selIdx = opnd1, nArgs = opnd2;
 		ClassOop cls = methodClass(proc)->superClass;
 		CacheOop cache = lits[selIdx].as<CacheOop>();
 		MethodOop meth;
@@ -593,7 +754,7 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		newCtx = newContext(proc, newBP);
 		newCtx->initWithMethod(omem, ac, meth);
 		for (int i = 0; i < nArgs; i++) {
-			newCtx->regAt0(i + 1) = CTX->regAt0(FETCH());
+			newCtx->regAt0(i + 1) = CTX->regAt0(FETCHREG());
 		}
 
 		SPILL();
@@ -608,27 +769,12 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		DISPATCH();
 	}
 
-	/** u8 prim-num, u8 num-args, (u8 arg-reg)+ */
-	opPrimitive : {
-		TESTCOUNTER();
-		unsigned prim = FETCH(), nArgs = FETCH();
-		ArrayOop args = ArrayOopDesc::newWithSize(omem, nArgs);
-
-		for (int i = 0; i < nArgs; i++)
-			args->basicAt0(i) = CTX->regAt0(FETCH());
-
-		SPILL();
-		ac = Primitive::primitives[prim].fnp(omem, proc, args);
-		if (proc.isNil()) /* yielded */
-			return -1;
-		UNSPILL();
-		DISPATCH();
-	}
-
 	/** ac arg, u8 prim-num */
-	opPrimitive0 : {
+	opPrimitive0 :
 		TESTCOUNTER();
-		unsigned prim = FETCH();
+		opnd1 = FETCH();
+	bodyPrimitive0 : {
+		unsigned prim = opnd1;
 		SPILL();
 		ac = Primitive::primitives[prim].fn0(omem, proc);
 		UNSPILL();
@@ -636,9 +782,11 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 	}
 
 	/** ac arg, u8 prim-num */
-	opPrimitive1 : {
+	opPrimitive1 :
 		TESTCOUNTER();
-		unsigned prim = FETCH();
+		opnd1 = FETCH();
+	bodyPrimitive1 : {
+		unsigned prim = opnd1;
 		SPILL();
 		ac = Primitive::primitives[prim].fn1(omem, proc, ac);
 		UNSPILL();
@@ -646,9 +794,12 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 	}
 
 	/** ac arg2, u8 prim-num, u8 arg1-reg */
-	opPrimitive2 : {
+	opPrimitive2 :
 		TESTCOUNTER();
-		unsigned prim = FETCH(), arg1reg = FETCH();
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodyPrimitive2 : {
+		unsigned prim = opnd1, arg1reg = opnd2;
 		SPILL();
 		ac = Primitive::primitives[prim].fn2(omem, proc, CTX->regAt0(arg1reg),
 		    ac);
@@ -657,9 +808,12 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 	}
 
 	/** ac arg3, u8 prim-num, u8 arg1-reg */
-	opPrimitive3 : {
+	opPrimitive3 :
 		TESTCOUNTER();
-		unsigned prim = FETCH(), arg1reg = FETCH();
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+	bodyPrimitive3 : {
+		unsigned prim = opnd1, arg1reg = opnd2;
 		SPILL();
 		ac = Primitive::primitives[prim].fn3(omem, proc, CTX->regAt0(arg1reg),
 		    CTX->regAt0(arg1reg + 1), ac);
@@ -667,9 +821,13 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		DISPATCH();
 	}
 
-	opPrimitiveV : {
+	opPrimitiveV :
 		TESTCOUNTER();
-		unsigned prim = FETCH(), nArgs = FETCH(), arg1reg = FETCH();
+		opnd1 = FETCH();
+		opnd2 = FETCH();
+		opnd3 = FETCH();
+	bodyPrimitiveV : {
+		unsigned prim = opnd1, nArgs = opnd2, arg1reg = opnd3;
 		SPILL();
 		ac = Primitive::primitives[prim].fnv(omem, proc, nArgs,
 		    &CTX->regAt0(arg1reg));
@@ -723,6 +881,160 @@ execute(ObjectMemory &omem, ProcessOop proc, volatile bool &interruptFlag) noexc
 		DISPATCH();
 	}
 
+	/*
+	 * Wide, opcode, then u16 operands in place of each u8. The timeslice is
+	 * tested here, before the opcode is fetched, so that an interrupted
+	 * instruction resumes at its prefix; the wide handlers then fetch the
+	 * operands and join the body of the narrow handler.
+	 */
+	opWide :
+		TESTCOUNTER();
+		goto *wideTable[FETCH()];
+
+	wideMoveParentHeapVarToMyHeapVars :
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodyMoveParentHeapVarToMyHeapVars;
+
+	wideMoveMyHeapVarToParentHeapVars :
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodyMoveMyHeapVarToParentHeapVars;
+
+	wideLdaParentHeapVar :
+		opnd1 = FETCH16();
+		goto bodyLdaParentHeapVar;
+
+	wideLdaMyHeapVar :
+		opnd1 = FETCH16();
+		goto bodyLdaMyHeapVar;
+
+	wideLdaGlobal :
+		opnd1 = FETCH16();
+		goto bodyLdaGlobal;
+
+	wideLdaNstVar :
+		opnd1 = FETCH16();
+		goto bodyLdaNstVar;
+
+	wideLdaLiteral :
+		opnd1 = FETCH16();
+		goto bodyLdaLiteral;
+
+	wideLdaCleanBlock :
+		opnd1 = FETCH16();
+		goto bodyLdaCleanBlock;
+
+	wideLdaBlockCopy :
+		opnd1 = FETCH16();
+		goto bodyLdaBlockCopy;
+
+	wideLdaBlockCopyCapturing :
+		wideRegs = true;
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodyLdaBlockCopyCapturing;
+
+	wideLdar :
+		opnd1 = FETCH16();
+		goto bodyLdar;
+
+	wideStaNstVar :
+		opnd1 = FETCH16();
+		goto bodyStaNstVar;
+
+	wideStaGlobal :
+		opnd1 = FETCH16();
+		goto bodyStaGlobal;
+
+	wideStaParentHeapVar :
+		opnd1 = FETCH16();
+		goto bodyStaParentHeapVar;
+
+	wideStaMyHeapVar :
+		opnd1 = FETCH16();
+		goto bodyStaMyHeapVar;
+
+	wideStar :
+		opnd1 = FETCH16();
+		goto bodyStar;
+
+	wideMove :
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodyMove;
+
+	wideAnd :
+		opnd1 = FETCH16();
+		goto bodyAnd;
+
+	wideBinOp :
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodyBinOp;
+
+	wideIdentEq :
+		opnd1 = FETCH16();
+		goto bodyIdentEq;
+
+	wideSend :
+		wideRegs = true;
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodySend;
+
+	wideSendSuper :
+		wideRegs = true;
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodySendSuper;
+
+	widePrimitive0 :
+		opnd1 = FETCH16();
+		goto bodyPrimitive0;
+
+	widePrimitive1 :
+		opnd1 = FETCH16();
+		goto bodyPrimitive1;
+
+	widePrimitive2 :
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodyPrimitive2;
+
+	widePrimitive3 :
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		goto bodyPrimitive3;
+
+	widePrimitiveV :
+		opnd1 = FETCH16();
+		opnd2 = FETCH16();
+		opnd3 = FETCH16();
+		goto bodyPrimitiveV;
+
+	/* these take no operands to widen */
+	wideLdaNil :
+	wideLdaTrue :
+	wideLdaFalse :
+	wideLdaThisContext :
+	wideLdaThisProcess :
+	wideLdaSmalltalk :
+	wideJump :
+	wideBranchIfFalse :
+	wideBranchIfTrue :
+	wideBranchIfNil :
+	wideBranchIfNotNil :
+	wideReturnSelf :
+	wideReturn :
+	wideBlockReturn :
+	wideLdaClassOf :
+	wideIsNil :
+	wideNotNil :
+	wideWide :
+		std::cerr << "Wide prefix to an instruction without operands\n";
+		abort();
+
 timesliceDone:
 	pc--;
 	SPILL();
@@ -11,7 +11,6 @@ struct Primitive {
 	static void initialise();
 	static Primitive *named(std::string name);
 
-	bool oldStyle;
 	enum Kind {
 		kNiladic,
 		kMonadic,
@@ -21,7 +20,6 @@ struct Primitive {
 	} kind; /* i.e. number of arguments */
 	const char *name;
 	union {
-		Oop (*fnp)(ObjectMemory &omem, ProcessOop proc, ArrayOop args);
 		Oop (*fn0)(ObjectMemory &omem, ProcessOop &proc);
 		Oop (*fn1)(ObjectMemory &omem, ProcessOop &proc, Oop a);
 		Oop (*fn2)(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b);
@@ -48,29 +46,37 @@ struct Primitive {
 	X(LdaNstVar)                     \
 	X(LdaLiteral)                    \
 	X(LdaBlockCopy)                  \
+	X(LdaCleanBlock)                 \
+	X(LdaBlockCopyCapturing) /* 15 */\
 	X(Ldar)                          \
-	X(StaNstVar)           /* 15 */  \
+	X(StaNstVar)                     \
 	X(StaGlobal)                     \
 	X(StaParentHeapVar)              \
-	X(StaMyHeapVar)                  \
+	X(StaMyHeapVar)        /* 20 */  \
 	X(Star)                          \
-	X(Move)                /* 20 */  \
+	X(Move)                          \
 	X(And)                           \
 	X(Jump)                          \
-	X(BranchIfFalse)                 \
-	X(BranchIfTrue)        /* 25 */  \
+	X(BranchIfFalse)       /* 25 */  \
+	X(BranchIfTrue)                  \
+	X(BranchIfNil)                   \
+	X(BranchIfNotNil)                \
 	X(BinOp)                         \
-	X(Send)                          \
+	X(Send)                /* 30 */  \
 	X(SendSuper)                     \
-	X(Primitive)                     \
 	X(Primitive0)                    \
 	X(Primitive1)                    \
 	X(Primitive2)                    \
 	X(Primitive3)                    \
-	X(PrimitiveV)                    \
+	X(PrimitiveV)          /* 35 */  \
 	X(ReturnSelf)                    \
 	X(Return)                        \
-	X(BlockReturn)
+	X(BlockReturn)                   \
+	X(IdentEq)                       \
+	X(LdaClassOf)          /* 40 */  \
+	X(IsNil)                         \
+	X(NotNil)                        \
+	X(Wide)
 
 class Op {
     public:
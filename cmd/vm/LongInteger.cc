@@ -0,0 +1,536 @@
+/**
+ * Arbitrary-precision integer arithmetic.
+ *
+ * Magnitudes are worked on as spans of 64-bit limbs, least significant first.
+ * Results are built up in std::vectors and only copied into a freshly
+ * allocated LongInteger once complete, so no pointer into the object heap is
+ * held across an allocation.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "ObjectMemory.hh"
+#include "Objects.hh"
+
+typedef LongIntegerOopDesc::Limb Limb;
+typedef unsigned __int128 DLimb;
+typedef std::vector<Limb> Limbs;
+
+/**
+ * A view of the sign and magnitude of an integer operand. A SmallInteger's
+ * magnitude is kept in #small, so an Operand must not be copied.
+ */
+struct Operand {
+	bool neg;
+	const Limb *d;
+	size_t n;
+	Limb small;
+
+	Operand() = default;
+	Operand(const Operand &) = delete;
+};
+
+static size_t
+trimmed(const Limb *d, size_t n)
+{
+	while (n > 0 && d[n - 1] == 0)
+		n--;
+	return n;
+}
+
+static bool
+operand(Oop oop, Operand &op)
+{
+	if (oop.isSmi()) {
+		int64_t val = oop.smi();
+		op.neg = val < 0;
+		op.small = op.neg ? -(Limb)val : (Limb)val;
+		op.d = &op.small;
+		op.n = op.small != 0;
+	} else if (oop.isa() == ObjectMemory::clsLongInteger) {
+		LongIntegerOop li = oop.as<LongIntegerOop>();
+		op.neg = li->isNegative();
+		op.d = li->limbs();
+		op.n = trimmed(op.d, li->nLimbs());
+	} else
+		return false;
+
+	if (op.n == 0)
+		op.neg = false;
+	return true;
+}
+
+static LongIntegerOop
+allocate(ObjectMemory &omem, bool neg, const Limb *d, size_t n)
+{
+	LongIntegerOop li = omem.newByteObj<LongIntegerOop>(
+	    (n + 1) * sizeof(Limb));
+	li.setIsa(ObjectMemory::clsLongInteger);
+	((Limb *)li->vns())[0] = neg;
+	std::copy(d, d + n, li->limbs());
+	return li;
+}
+
+/**
+ * Returns a SmallInteger if the value fits in one, otherwise a new
+ * LongInteger.
+ */
+static Oop
+normalise(ObjectMemory &omem, bool neg, const Limb *d, size_t n)
+{
+	n = trimmed(d, n);
+
+	if (n == 0)
+		return Smi((int64_t)0);
+	else if (n == 1 && !neg && d[0] <= (Limb)VT_smiMax)
+		return Smi((int64_t)d[0]);
+	else if (n == 1 && neg && d[0] <= (Limb)VT_smiMax + 1)
+		return Smi(-(int64_t)d[0]);
+
+	return allocate(omem, neg, d, n);
+}
+
+/**
+ * \defgroup Magnitude operations
+ * @{
+ */
+
+static int
+magCmp(const Limb *a, size_t na, const Limb *b, size_t nb)
+{
+	na = trimmed(a, na);
+	nb = trimmed(b, nb);
+
+	if (na != nb)
+		return na < nb ? -1 : 1;
+	while (na-- > 0)
+		if (a[na] != b[na])
+			return a[na] < b[na] ? -1 : 1;
+	return 0;
+}
+
+/** r[0..na] = a + b; requires na >= nb. */
+static void
+magAdd(const Limb *a, size_t na, const Limb *b, size_t nb, Limb *r)
+{
+	Limb carry = 0;
+	size_t i;
+
+	for (i = 0; i < nb; i++) {
+		DLimb sum = (DLimb)a[i] + b[i] + carry;
+		r[i] = (Limb)sum;
+		carry = sum >> 64;
+	}
+	for (; i < na; i++) {
+		DLimb sum = (DLimb)a[i] + carry;
+		r[i] = (Limb)sum;
+		carry = sum >> 64;
+	}
+	r[na] = carry;
+}
+
+/** r[0..na) = a - b; requires a >= b. */
+static void
+magSub(const Limb *a, size_t na, const Limb *b, size_t nb, Limb *r)
+{
+	Limb borrow = 0;
+	size_t i;
+
+	for (i = 0; i < nb; i++) {
+		Limb diff = a[i] - b[i] - borrow;
+		borrow = a[i] < b[i] || (a[i] == b[i] && borrow);
+		r[i] = diff;
+	}
+	for (; i < na; i++) {
+		Limb diff = a[i] - borrow;
+		borrow = a[i] < borrow;
+		r[i] = diff;
+	}
+	assert(!borrow);
+}
+
+/** r += t; the sum must fit within nr limbs. */
+static void
+magAddInPlace(Limb *r, size_t nr, const Limb *t, size_t nt)
+{
+	Limb carry = 0;
+	size_t i;
+
+	nt = trimmed(t, nt);
+	assert(nt <= nr);
+	for (i = 0; i < nt; i++) {
+		DLimb sum = (DLimb)r[i] + t[i] + carry;
+		r[i] = (Limb)sum;
+		carry = sum >> 64;
+	}
+	for (; carry && i < nr; i++) {
+		r[i] += carry;
+		carry = r[i] == 0;
+	}
+	assert(!carry);
+}
+
+/** r -= t; requires r >= t. */
+static void
+magSubInPlace(Limb *r, size_t nr, const Limb *t, size_t nt)
+{
+	nt = trimmed(t, nt);
+	assert(nt <= nr);
+	magSub(r, nr, t, nt, r);
+}
+
+static void
+magMulSchoolbook(const Limb *a, size_t na, const Limb *b, size_t nb, Limb *r)
+{
+	std::fill(r, r + na + nb, 0);
+	for (size_t i = 0; i < na; i++) {
+		Limb carry = 0;
+
+		for (size_t j = 0; j < nb; j++) {
+			DLimb t = (DLimb)a[i] * b[j] + r[i + j] + carry;
+			r[i + j] = (Limb)t;
+			carry = t >> 64;
+		}
+		r[i + nb] = carry;
+	}
+}
+
+/**
+ * r[0..na + nb) = a * b. Uses Karatsuba's method when both operands are at
+ * least karatsubaThreshold limbs long; an operand much shorter than the other
+ * is instead multiplied against halves of the longer.
+ */
+static void
+magMul(const Limb *a, size_t na, const Limb *b, size_t nb, Limb *r)
+{
+	if (na < nb) {
+		std::swap(a, b);
+		std::swap(na, nb);
+	}
+
+	if (nb < LongIntegerOopDesc::karatsubaThreshold) {
+		magMulSchoolbook(a, na, b, nb, r);
+		return;
+	}
+
+	size_t m = (na + 1) / 2;
+
+	if (nb <= m) {
+		/* r = a0 * b + (a1 * b << m) */
+		Limbs hi(na - m + nb);
+
+		magMul(a, m, b, nb, r);
+		std::fill(r + m + nb, r + na + nb, 0);
+		magMul(a + m, na - m, b, nb, hi.data());
+		magAddInPlace(r + m, na + nb - m, hi.data(), hi.size());
+		return;
+	}
+
+	/*
+	 * With a = a1 * B^m + a0 and b = b1 * B^m + b0:
+	 *   a * b = z2 * B^2m + z1 * B^m + z0
+	 * where z0 = a0 * b0, z2 = a1 * b1, and
+	 *   z1 = (a0 + a1) * (b0 + b1) - z0 - z2.
+	 */
+	size_t na1 = na - m, nb1 = nb - m;
+	Limbs sa(m + 1), sb(m + 1), z1(2 * m + 2);
+
+	magAdd(a, m, a + m, na1, sa.data());
+	magAdd(b, m, b + m, nb1, sb.data());
+	magMul(sa.data(), m + 1, sb.data(), m + 1, z1.data());
+
+	magMul(a, m, b, m, r);
+	magMul(a + m, na1, b + m, nb1, r + 2 * m);
+
+	magSubInPlace(z1.data(), z1.size(), r, 2 * m);
+	magSubInPlace(z1.data(), z1.size(), r + 2 * m, na1 + nb1);
+	magAddInPlace(r + m, na + nb - m, z1.data(), z1.size());
+}
+
+/**
+ * Divides a (in place) by a single limb, returning the remainder.
+ */
+static Limb
+magDivSmall(Limb *a, size_t na, Limb b)
+{
+	DLimb rem = 0;
+
+	for (size_t i = na; i-- > 0;) {
+		DLimb cur = (rem << 64) | a[i];
+		a[i] = (Limb)(cur / b);
+		rem = cur % b;
+	}
+
+	return (Limb)rem;
+}
+
+/**
+ * Knuth's Algorithm D. Requires na >= nb, and b trimmed and non-zero.
+ * q receives na - nb + 1 limbs; rem receives nb limbs.
+ */
+static void
+magDivMod(const Limb *a, size_t na, const Limb *b, size_t nb, Limb *q,
+    Limb *rem)
+{
+	if (nb == 1) {
+		std::copy(a, a + na, q);
+		rem[0] = magDivSmall(q, na, b[0]);
+		return;
+	}
+
+	/* normalise so that the divisor's top bit is set */
+	int s = __builtin_clzll(b[nb - 1]);
+	Limbs un(na + 1), vn(nb);
+
+	for (size_t i = nb; i-- > 0;)
+		vn[i] = (b[i] << s) | (s && i ? b[i - 1] >> (64 - s) : 0);
+	un[na] = s ? a[na - 1] >> (64 - s) : 0;
+	for (size_t i = na; i-- > 0;)
+		un[i] = (a[i] << s) | (s && i ? a[i - 1] >> (64 - s) : 0);
+
+	for (size_t j = na - nb + 1; j-- > 0;) {
+		DLimb num = ((DLimb)un[j + nb] << 64) | un[j + nb - 1];
+		DLimb qhat = num / vn[nb - 1];
+		DLimb rhat = num % vn[nb - 1];
+		Limb carry = 0, borrow = 0;
+
+		while ((qhat >> 64) ||
+		    qhat * vn[nb - 2] > ((rhat << 64) | un[j + nb - 2])) {
+			qhat--;
+			rhat += vn[nb - 1];
+			if (rhat >> 64)
+				break;
+		}
+
+		/* un[j..j + nb] -= qhat * vn */
+		for (size_t i = 0; i < nb; i++) {
+			DLimb p = qhat * vn[i] + carry;
+			Limb plo = (Limb)p;
+			Limb u = un[i + j];
+
+			carry = p >> 64;
+			un[i + j] = u - plo - borrow;
+			borrow = u < plo || (u - plo) < borrow;
+		}
+		Limb u = un[j + nb];
+		un[j + nb] = u - carry - borrow;
+		q[j] = (Limb)qhat;
+
+		if (u < carry || (u - carry) < borrow) {
+			/* qhat was one too large; add the divisor back */
+			Limb c = 0;
+
+			q[j]--;
+			for (size_t i = 0; i < nb; i++) {
+				DLimb sum = (DLimb)un[i + j] + vn[i] + c;
+				un[i + j] = (Limb)sum;
+				c = sum >> 64;
+			}
+			un[j + nb] += c;
+		}
+	}
+
+	for (size_t i = 0; i < nb; i++)
+		rem[i] = (un[i] >> s) | (s ? un[i + 1] << (64 - s) : 0);
+}
+
+/**
+ * @}
+ */
+
+static Oop
+addSigned(ObjectMemory &omem, Operand &a, Operand &b, bool bNeg)
+{
+	if (a.neg == bNeg) {
+		Operand &big = a.n >= b.n ? a : b, &little = a.n >= b.n ? b : a;
+		Limbs r(big.n + 1);
+
+		magAdd(big.d, big.n, little.d, little.n, r.data());
+		return normalise(omem, a.neg, r.data(), r.size());
+	} else if (magCmp(a.d, a.n, b.d, b.n) >= 0) {
+		Limbs r(a.n);
+
+		magSub(a.d, a.n, b.d, b.n, r.data());
+		return normalise(omem, a.neg, r.data(), r.size());
+	} else {
+		Limbs r(b.n);
+
+		magSub(b.d, b.n, a.d, a.n, r.data());
+		return normalise(omem, bNeg, r.data(), r.size());
+	}
+}
+
+LongIntegerOop
+LongIntegerOopDesc::fromInt64(ObjectMemory &omem, int64_t value)
+{
+	Limb mag = value < 0 ? -(Limb)value : (Limb)value;
+	return allocate(omem, value < 0, &mag, 1);
+}
+
+bool
+LongIntegerOopDesc::isInteger(Oop oop)
+{
+	return oop.isSmi() || oop.isa() == ObjectMemory::clsLongInteger;
+}
+
+Oop
+LongIntegerOopDesc::add(ObjectMemory &omem, Oop a, Oop b)
+{
+	Operand opA, opB;
+
+	if (!operand(a, opA) || !operand(b, opB))
+		return Oop::nil();
+	return addSigned(omem, opA, opB, opB.neg);
+}
+
+Oop
+LongIntegerOopDesc::sub(ObjectMemory &omem, Oop a, Oop b)
+{
+	Operand opA, opB;
+
+	if (!operand(a, opA) || !operand(b, opB))
+		return Oop::nil();
+	return addSigned(omem, opA, opB, opB.n && !opB.neg);
+}
+
+Oop
+LongIntegerOopDesc::mul(ObjectMemory &omem, Oop a, Oop b)
+{
+	Operand opA, opB;
+
+	if (!operand(a, opA) || !operand(b, opB))
+		return Oop::nil();
+	if (opA.n == 0 || opB.n == 0)
+		return Smi((int64_t)0);
+
+	Limbs r(opA.n + opB.n);
+	magMul(opA.d, opA.n, opB.d, opB.n, r.data());
+	return normalise(omem, opA.neg != opB.neg, r.data(), r.size());
+}
+
+Oop
+LongIntegerOopDesc::quoRem(ObjectMemory &omem, Oop a, Oop b, Oop &rem)
+{
+	Operand opA, opB;
+
+	if (!operand(a, opA) || !operand(b, opB) || opB.n == 0)
+		return Oop::nil();
+
+	if (magCmp(opA.d, opA.n, opB.d, opB.n) < 0) {
+		rem = a;
+		return Smi((int64_t)0);
+	}
+
+	Limbs q(opA.n - opB.n + 1), r(opB.n);
+	magDivMod(opA.d, opA.n, opB.d, opB.n, q.data(), r.data());
+
+	/* allocating the quotient may move the operands; rem is done last */
+	Oop quo = normalise(omem, opA.neg != opB.neg, q.data(), q.size());
+	rem = normalise(omem, opA.neg, r.data(), r.size());
+	return quo;
+}
+
+Oop
+LongIntegerOopDesc::bitShift(ObjectMemory &omem, Oop a, int64_t shift)
+{
+	Operand op;
+
+	if (!operand(a, op) || shift > INT32_MAX || shift < INT32_MIN)
+		return Oop::nil();
+	if (op.n == 0)
+		return Smi((int64_t)0);
+
+	if (shift >= 0) {
+		size_t limbShift = shift / 64, bits = shift % 64;
+		Limbs r(op.n + limbShift + 1);
+
+		for (size_t i = 0; i < op.n; i++) {
+			r[i + limbShift] |= op.d[i] << bits;
+			if (bits)
+				r[i + limbShift + 1] = op.d[i] >> (64 - bits);
+		}
+		return normalise(omem, op.neg, r.data(), r.size());
+	}
+
+	size_t limbShift = -shift / 64, bits = -shift % 64;
+	Limbs src(op.d, op.d + op.n);
+
+	/* floor(-m / 2^s) = -(((m - 1) >> s) + 1) */
+	if (op.neg) {
+		Limb one = 1;
+		magSub(src.data(), src.size(), &one, 1, src.data());
+	}
+
+	if (limbShift >= src.size())
+		return Smi((int64_t)(op.neg ? -1 : 0));
+
+	Limbs r(src.size() - limbShift + 1);
+	for (size_t i = limbShift; i < src.size(); i++) {
+		r[i - limbShift] = src[i] >> bits;
+		if (bits && i + 1 < src.size())
+			r[i - limbShift] |= src[i + 1] << (64 - bits);
+	}
+
+	if (op.neg) {
+		Limb one = 1;
+		magAddInPlace(r.data(), r.size(), &one, 1);
+	}
+
+	return normalise(omem, op.neg, r.data(), r.size());
+}
+
+int
+LongIntegerOopDesc::compare(Oop a, Oop b)
+{
+	Operand opA, opB;
+	int cmp;
+
+	if (!operand(a, opA) || !operand(b, opB))
+		abort();
+
+	if (opA.neg != opB.neg)
+		return opA.neg ? -1 : 1;
+	cmp = magCmp(opA.d, opA.n, opB.d, opB.n);
+	return opA.neg ? -cmp : cmp;
+}
+
+std::string
+LongIntegerOopDesc::printString(Oop a, unsigned radix)
+{
+	static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	Operand op;
+	Limb chunk = radix;
+	size_t chunkDigits = 1;
+	std::string str;
+
+	if (radix < 2 || radix > 36 || !operand(a, op))
+		return "";
+	if (op.n == 0)
+		return "0";
+
+	/* peel off as many digits per division as a limb can hold */
+	while (chunk <= UINT64_MAX / radix) {
+		chunk *= radix;
+		chunkDigits++;
+	}
+
+	Limbs mag(op.d, op.d + op.n);
+	size_t n = mag.size();
+
+	while (n > 0) {
+		Limb rem = magDivSmall(mag.data(), n, chunk);
+
+		n = trimmed(mag.data(), n);
+		for (size_t i = 0; i < chunkDigits && (n > 0 || rem); i++) {
+			str.push_back(digits[rem % radix]);
+			rem /= radix;
+		}
+	}
+
+	if (op.neg)
+		str.push_back('-');
+	std::reverse(str.begin(), str.end());
+	return str;
+}
@@ -1,5 +1,10 @@
 #include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <stdexcept>
 
 #include "AST.hh"
 #include "Compiler.hh"
@@ -8,9 +13,34 @@
 #include "Typecheck.hh"
 #include "Interpreter.hh"
 #include "CPUThread.hh"
+#include "Generation.hh"
 
 extern void run(ObjectMemory & omem);
 
+static int
+usage(const char *progName)
+{
+	fprintf(stderr, "usage: %s [--dump-bytecode] [--timeslice ms] "
+	    "file.st\n", progName);
+	return EXIT_FAILURE;
+}
+
+/* the same range primSetTimeSlice accepts; 0 selects the adaptive quantum */
+static bool
+parseTimeSlice(const char *str, int &ms)
+{
+	char *end;
+	long val;
+
+	errno = 0;
+	val = strtol(str, &end, 10);
+	if (errno != 0 || end == str || *end != '\0' || val < 0 ||
+	    val > INT_MAX)
+		return false;
+	ms = val;
+	return true;
+}
+
 int
 main(int argc, char * argv[])
 {
@@ -19,6 +49,22 @@ main(int argc, char * argv[])
 	ProcessOop firstProcess;
 	MethodOop start;
 	ClassOop initial;
+	const char *fName = NULL;
+
+	for (int i = 1; i < argc; i++)
+		if (!strcmp(argv[i], "--dump-bytecode"))
+			CodeGen::dumpBytecode = true;
+		else if (!strcmp(argv[i], "--timeslice") && i + 1 < argc) {
+			int ms;
+
+			if (!parseTimeSlice(argv[++i], ms))
+				return usage(argv[0]);
+			CPUThreadPair::setTimeSlice(ms);
+		} else
+			fName = argv[i];
+
+	if (fName == NULL)
+		return usage(argv[0]);
 
 	printf("Valutron\n");
 	printf("GC: " VT_GCNAME "\n");
@@ -26,13 +72,22 @@ main(int argc, char * argv[])
 	Primitive::initialise();
 	omem.setupInitialObjects();
 
-	ProgramNode *node = MVST_Parser::parseFile(argv[1]);
-	SynthContext sctx(omem);
-	node->registerNames(sctx);
-	node->synth(sctx);
-	node->typeReg(sctx.tyChecker());
-	node->typeCheck(sctx.tyChecker());
-	node->generate(omem);
+	/*
+	 * a file the compiler cannot handle is reported cleanly, and we exit,
+	 * instead of aborting on an uncaught exception
+	 */
+	try {
+		ProgramNode *node = MVST_Parser::parseFile(fName);
+		SynthContext sctx(omem);
+		node->registerNames(sctx);
+		node->synth(sctx);
+		node->typeReg(sctx.tyChecker());
+		node->typeCheck(sctx.tyChecker());
+		node->generate(omem);
+	} catch (std::runtime_error &e) {
+		fprintf(stderr, "%s: compile error: %s\n", fName, e.what());
+		return EXIT_FAILURE;
+	}
 
 	initial = ObjectMemory::objGlobals->symbolLookup(
 	    SymbolOopDesc::fromString(omem, "INITIAL")).as<ClassOop>();
@@ -258,15 +258,15 @@ ObjectMemory::setupInitialObjects()
 	CreateObj(Nil, 0);
 	CreateObj(True, 0);
 	CreateObj(False, 0);
-	objSymbolTable = newOopObj<DictionaryOop>(1);
-	objGlobals = newOopObj<DictionaryOop>(1);
 	CreateObj(smalltalk, 0);
 
 	clsSymbol = ClassOopDesc::allocateRawClass(*this);
 	clsArray = ClassOopDesc::allocateRawClass(*this);
 
-	objSymbolTable->basicAtPut0(0, ArrayOopDesc::newWithSize(*this, 3 * 53));
-	objGlobals->basicAtPut0(0, ArrayOopDesc::newWithSize(*this, 3 * 53));
+	/* their class is set once it exists */
+	objSymbolTable = DictionaryOopDesc::newWithSize(*this, 512);
+	objGlobals = DictionaryOopDesc::newWithSize(*this, 128);
+	objGlobalBindings = DictionaryOopDesc::newWithSize(*this, 128);
 
 	objGlobals->symbolInsert(*this,
 	    SymbolOopDesc::fromString(*this, "Symbol"), clsSymbol);
@@ -284,6 +284,7 @@ ObjectMemory::setupInitialObjects()
 	clsObject.setIsa(clsObjectClass);
 	clsObjectClass.setIsa(clsObjectClass);
 	CreateClass(Integer);
+	CreateClass(LongInteger);
 	CreateClass(ByteArray);
 	CreateClass(String);
 	CreateClass(Method);
@@ -317,6 +318,7 @@ ObjectMemory::setupInitialObjects()
 	objFalse.setIsa(clsFalse);
 	objSymbolTable.setIsa(clsDictionary);
 	objGlobals.setIsa(clsSystemDictionary);
+	objGlobalBindings.setIsa(clsSymbolTable);
 
 	for (int i = 0; i < sizeof(binOpStr) / sizeof(*binOpStr); i++)
 		symBin[i] = SymbolOopDesc::fromString(*this, binOpStr[i]);
@@ -328,6 +330,21 @@ ClassOop ObjectMemory::lookupClass(std::string name)
 		as<ClassOop>();
 }
 
+AssociationLinkOop
+ObjectMemory::globalBinding(SymbolOop name)
+{
+	AssociationLinkOop binding = objGlobalBindings->symbolLookup(name)
+	    .as<AssociationLinkOop>();
+
+	if (binding.isNil()) {
+		binding = AssociationLinkOopDesc::newWith(*this, name,
+		    objGlobals->symbolLookup(name));
+		objGlobalBindings->symbolInsert(*this, name, binding);
+	}
+
+	return binding;
+}
+
 
 void
 ObjectMemory::poll()
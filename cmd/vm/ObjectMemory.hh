@@ -85,7 +85,7 @@ class ObjectMemory : public ObjectAllocator<ObjectMemory> {
 		X(DictionaryOop, objSymbolTable)\
 		X(DictionaryOop, objGlobals)	\
 		X(MemOop, objsmalltalk)		\
-		X(MemOop, objUnused1)		\
+		X(DictionaryOop, objGlobalBindings)\
 		X(MemOop, objUnused2)		\
 		X(MemOop, objUnused3)		\
 		X(MemOop, objMinClass)		\
@@ -112,7 +112,8 @@ class ObjectMemory : public ObjectAllocator<ObjectMemory> {
 		X(ClassOop, clsCharacter)	\
 		X(ClassOop, clsProcessor)	\
 		X(ClassOop, clsNativePointer)	\
-		X(ClassOop, clsStackFrame)
+		X(ClassOop, clsStackFrame)	\
+		X(ClassOop, clsLongInteger)
 
 #define X(TYPE, NAME) static TYPE NAME;
 	OMEM_STATICS
@@ -137,6 +138,13 @@ class ObjectMemory : public ObjectAllocator<ObjectMemory> {
 	ClassOop findOrCreateClass(ClassOop superClass, std::string name);
 	ClassOop lookupClass(std::string name);
 
+	/**
+	 * Returns the binding cell for the global \p name, an AssociationLink
+	 * of name and value, creating it if need be. Code refers to globals
+	 * through these, which are updated whenever the global is (re)defined.
+	 */
+	AssociationLinkOop globalBinding(SymbolOop name);
+
 	/**
 	 * Performs a cold boot of the Object Manager. Essential objects are
 	 * provisionally set up such that it is possible to compile code and
@@ -25,6 +25,9 @@ void OopRef<T>::print(size_t in)
         as<ClassName##Oop> ()->print (in)
     else if (isa () == ObjectMemory::clsInteger)
         std::cout << blanks(in) << smi() << "\n";
+    else if (isa () == ObjectMemory::clsLongInteger)
+        std::cout << blanks(in) << LongIntegerOopDesc::printString(*this)
+                  << "\n";
     else if (isa () == ObjectMemory::clsString)
         as<SymbolOop> ()->print (in);
     Case (Array);
@@ -41,21 +44,43 @@ void OopRef<T>::print(size_t in)
                    << " .\n";
 }
 
+/** Multiplies \p a by \p b and folds the 128-bit product, as wyhash does. */
+static inline uint64_t
+mum(uint64_t a, uint64_t b)
+{
+	__uint128_t product = (__uint128_t)a * b;
+
+	return uint64_t(product) ^ uint64_t(product >> 64);
+}
+
+/**
+ * Hashes a string eight bytes at a time, each word being mixed into the state
+ * by a folded multiply, and the result avalanched. The hash is cut to 23 bits
+ * so that a symbol can keep it as its (24-bit, signed) hash code.
+ */
 int
 strHash(std::string str)
 {
-	int32_t hash;
-	const char *p;
+	const uint64_t k0 = 0xa0761d6478bd642full, k1 = 0xe7037ed1a0b428dbull;
+	const char *p = str.data();
+	size_t len = str.size();
+	uint64_t hash = len ^ k0;
 
-	hash = 0;
-	for (p = str.c_str(); *p; p++)
-		hash += *p;
-	if (hash < 0)
-		hash = -hash;
-	/* scale to proper size */
-	while (hash > (1 << 24))
-		hash >>= 2;
-	return hash;
+	for (; len >= 8; p += 8, len -= 8) {
+		uint64_t word;
+
+		memcpy(&word, p, 8);
+		hash = mum(hash ^ word, k1);
+	}
+	if (len > 0) {
+		uint64_t word = 0;
+
+		memcpy(&word, p, len);
+		hash = mum(hash ^ word, k1);
+	}
+
+	hash = mum(hash ^ (hash >> 32), k0);
+	return hash >> 41;
 }
 
 Klass gKlass;
@@ -267,63 +292,179 @@ void ContextOopDesc::print (int in)
  */
 
 int
-hashCmp(Oop key, Oop match)
+identityTest(Oop key, Oop match)
+{
+	return key == match;
+}
+
+/** Returns the smallest power of two capacity holding \p n under the limit. */
+static size_t
+capacityFor(size_t n)
+{
+	size_t capacity = 8;
+
+	while (n * 4 > capacity * 3)
+		capacity *= 2;
+	return capacity;
+}
+
+/** Returns the first empty entry probed from \p hash in \p table. */
+static Oop *
+emptyEntry(ArrayOop table, uint32_t hash)
 {
-	/*  DEBUG  printf ("Compare %s to %s\n",
-		   key->asStringOop ()->asCStr (),
-		   match->asStringOop ()->asCStr ());*/
-	return key.hashCode() == match.hashCode();
+	size_t mask = table->size() / DictionaryOopDesc::kEntrySize - 1;
+	Oop *entries = (Oop *)table->vns();
+
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		Oop *entry = entries + i * DictionaryOopDesc::kEntrySize;
+
+		if (entry[0].isNil())
+			return entry;
+	}
+}
+
+enum Equality {
+	kUnequal,
+	kEqual,
+	kUndecided,
+};
+
+/**
+ * Determines whether \p key = \p match, where the answer is plain from the
+ * VM's side: for SmallIntegers, Symbols, Strings and Characters. (Symbols
+ * compare by identity, and no two of these classes compare equal.) Whether
+ * instances of other classes are equal is for Smalltalk to decide.
+ */
+static Equality
+keysEqual(Oop key, Oop match)
+{
+	ClassOop keyCls, matchCls;
+
+	if (key == match)
+		return kEqual;
+
+	keyCls = key.isa();
+	matchCls = match.isa();
+	if (keyCls != ObjectMemory::clsInteger &&
+	    keyCls != ObjectMemory::clsSymbol &&
+	    keyCls != ObjectMemory::clsString &&
+	    keyCls != ObjectMemory::clsCharacter)
+		return kUndecided;
+	else if (keyCls != matchCls)
+		return matchCls == ObjectMemory::clsInteger ||
+			matchCls == ObjectMemory::clsSymbol ||
+			matchCls == ObjectMemory::clsString ||
+			matchCls == ObjectMemory::clsCharacter ?
+		    kUnequal : kUndecided;
+	else if (keyCls == ObjectMemory::clsString)
+		return strcmp(key.as<StringOop>()->asCStr(),
+			   match.as<StringOop>()->asCStr()) ? kUnequal : kEqual;
+	else if (keyCls == ObjectMemory::clsCharacter)
+		return key.as<CharOop>()->value() == match.as<CharOop>()->value() ?
+		    kEqual : kUnequal;
+	else
+		return kUnequal;
+}
+
+Oop *
+DictionaryOopDesc::entryFor(uint32_t hash, Oop key, bool identity)
+{
+	ArrayOop table = this->table();
+	size_t mask = table->size() / kEntrySize - 1;
+	Oop *entries = (Oop *)table->vns();
+
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		Oop *entry = entries + i * kEntrySize;
+
+		if (entry[0].isNil() || entry[0] == key)
+			return entry;
+		if (identity || uint32_t(entry[2].smi()) != hash)
+			continue;
+
+		switch (keysEqual(entry[0], key)) {
+		case kEqual:
+			return entry;
+		case kUndecided:
+			return NULL;
+		case kUnequal:
+			break;
+		}
+	}
 }
 
 void
-DictionaryOopDesc::insert(ObjectMemory &omem, intptr_t hash, Oop key, Oop value)
+DictionaryOopDesc::fillEntry(ObjectMemory &omem, Oop *entry, uint32_t hash,
+    Oop key, Oop value)
 {
-	ArrayOop table;
-	AssociationLinkOop link, nwLink, nextLink;
-	Oop tablentry;
+	entry[0] = key;
+	entry[1] = value;
+	entry[2] = Smi((int64_t)hash);
+	setTally(Smi(tally().smi() + 1));
 
-	/* first get the hash table */
-	table = basicAt0(0).as<ArrayOop>();
+	if (tally().smi() * 4 > table()->size() / kEntrySize * 3)
+		grow(omem);
+}
 
-	if (table->size() < 3) {
-		perror("attempt to insert into too small name table");
-	} else {
-		hash = 3 * (hash % (table->size() / 3));
-		assert(hash <= table->size() - 3);
-		tablentry = table->basicAt0(hash);
-
-		/* FIXME: I adapted this from the PDST C sources, and this
-		 * doesn't appear to handle anything other than symbols (because
-		 * of tablentry == key). Make it a template in the future or
-		 * make it accept a comparison callback like findPairByFun() in
-		 * the future, maybe?
-		 */
-		if (tablentry.isNil() || (tablentry == key)) {
-			table->basicAtPut0(hash, key);
-			table->basicAtPut0(hash + 1, value);
-		} else {
-			nwLink = AssociationLinkOopDesc::newWith(omem, key, value);
-			link = table->basicAt0(hash + 2).as<AssociationLinkOop>();
-			if (link.isNil()) {
-				table->basicAtPut0(hash + 2, nwLink);
-			} else
-				while (1)
-					/* ptrEq (orefOf (link, 1),
-					 * (objRef)key)) */
-					if (link->one() == key) {
-						/* get rid of unwanted AssociationLink */
-						// isVolatilePut (nwLink,
-						// false);
-						link->setTwo(value);
-						break;
-					} else if ((nextLink = link->nextLink())
-						       .isNil()) {
-						link->setNextLink(nwLink);
-						break;
-					} else
-						link = nextLink;
+void
+DictionaryOopDesc::removeEntry(Oop *entry)
+{
+	ArrayOop table = this->table();
+	size_t mask = table->size() / kEntrySize - 1;
+	Oop *entries = (Oop *)table->vns();
+	size_t hole = (entry - entries) / kEntrySize;
+
+	/*
+	 * later entries of the probe run, which could no longer be found past
+	 * the hole, are moved back into it
+	 */
+	for (size_t i = (hole + 1) & mask; !entries[i * kEntrySize].isNil();
+	     i = (i + 1) & mask) {
+		size_t home = entries[i * kEntrySize + 2].smi() & mask;
+		bool reachable = hole <= i ? hole < home && home <= i :
+		    hole < home || home <= i;
+
+		if (!reachable) {
+			std::copy(entries + i * kEntrySize,
+			    entries + (i + 1) * kEntrySize,
+			    entries + hole * kEntrySize);
+			hole = i;
 		}
 	}
+
+	std::fill(entries + hole * kEntrySize,
+	    entries + (hole + 1) * kEntrySize, Oop());
+	setTally(Smi(tally().smi() - 1));
+}
+
+void
+DictionaryOopDesc::grow(ObjectMemory &omem)
+{
+	ArrayOop oldTable = table();
+	size_t oldCapacity = oldTable->size() / kEntrySize;
+	ArrayOop newTable = ArrayOopDesc::newWithSize(omem,
+	    oldCapacity * 2 * kEntrySize);
+
+	for (size_t i = 0; i < oldCapacity; i++) {
+		Oop *entry = (Oop *)oldTable->vns() + i * kEntrySize;
+
+		if (entry[0].isNil())
+			continue;
+		std::copy(entry, entry + kEntrySize,
+		    emptyEntry(newTable, entry[2].smi()));
+	}
+
+	setTable(newTable);
+}
+
+void
+DictionaryOopDesc::insert(ObjectMemory &omem, intptr_t hash, Oop key, Oop value)
+{
+	Oop *entry = entryFor(hash, key, true);
+
+	if (entry[0].isNil())
+		fillEntry(omem, entry, hash, key, value);
+	else
+		entry[1] = value;
 }
 
 template <typename ExtraType>
@@ -331,36 +472,19 @@ std::pair<Oop, Oop>
 DictionaryOopDesc::findPairByFun(uint32_t hash, ExtraType extraVal,
     int (*fun)(Oop, ExtraType))
 {
-	ArrayOop table = basicAt0(0).as<ArrayOop>();
-	Oop key, value;
-	AssociationLinkOop link;
-	Oop *hp;
-	int tablesize=table->size();
+	ArrayOop table = this->table();
+	size_t mask = table->size() / kEntrySize - 1;
+	Oop *entries = (Oop *)table->vns();
 
-	/* now see if table is valid */
-	if (tablesize < 3) {
-		printf("Table Size: %d\n", tablesize);
-		perror("system error lookup on null table");
-	} else {
-		hash = 1 + (3 * (hash % (tablesize / 3)));
-		assert(hash <= tablesize - 2);
-		hp = (Oop *)table->vns() + (hash - 1);
-		key = *hp++;   /* table at: hash */
-		value = *hp++; /* table at: hash + 1 */
-		if ((!key.isNil()) && (*fun)(key, extraVal))
-			return { key, value };
-		/* check for linked */
-		for (link = *(AssociationLinkOop *)hp; !link.isNil();
-		     link = *(AssociationLinkOop *)hp) {
-			hp = (Oop *)link->vns();
-			key = *hp++;   /* link at: 1 */
-			value = *hp++; /* link at: 2 */
-			if (!key.isNil() && (*fun)(key, extraVal))
-				return { key, value };
-		}
-	}
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		Oop *entry = entries + i * kEntrySize;
 
-	return { Oop(), Oop() };
+		if (entry[0].isNil())
+			return { Oop(), Oop() };
+		if (uint32_t(entry[2].smi()) == hash &&
+		    (*fun)(entry[0], extraVal))
+			return { entry[0], entry[1] };
+	}
 }
 
 ClassOop
@@ -428,57 +552,38 @@ DictionaryOopDesc::symbolLookupNamespaced(ObjectMemory &omem, std::string name)
 }
 
 DictionaryOop
-DictionaryOopDesc::newWithSize(ObjectMemory &omem, size_t numBuckets)
+DictionaryOopDesc::newWithSize(ObjectMemory &omem, size_t numEntries)
 {
-	DictionaryOop dict = omem.newOopObj<DictionaryOop>(1);
+	DictionaryOop dict = omem.newOopObj<DictionaryOop>(clsNstLength);
 	dict->setIsa(ObjectMemory::clsDictionary);
-	dict->basicAtPut0(0, ArrayOopDesc::newWithSize(omem, numBuckets * 3));
+	dict->setTable(ArrayOopDesc::newWithSize(omem,
+	    capacityFor(numEntries) * kEntrySize));
+	dict->setTally(Smi((int64_t)0));
 	return dict;
 }
 
 void
 DictionaryOopDesc::print(int in)
 {
-	ArrayOop table = basicAt0(0).as<ArrayOop>();
-	Oop key, value;
-	AssociationLinkOop link;
-	Oop *hp;
-	int tablesize;
+	ArrayOop table = this->table();
 
 	std::cout << blanks(in) + "Dictionary {\n";
 
-	/* now see if table is valid */
-	if ((tablesize = table->size()) < 3) {
-		printf("In Print: Table Size: %d\n", tablesize);
-		perror("system error lookup on null table");
-	}
-	for (int i = 1; i <= table->size(); i += 3) {
-		hp = (Oop *)table->vns() + (i - 1);
-		key = *hp++;   /* table at: hash */
-		value = *hp++; /* table at: hash + 1 */
+	for (size_t i = 0; i < table->size(); i += kEntrySize) {
+		Oop key = table->basicAt0(i), value = table->basicAt0(i + 1);
+
+		if (key.isNil())
+			continue;
 
 		std::cout << blanks(in + 1) + "{ Key:\n";
 		key.print(in + 2);
 		std::cout << blanks(in + 1) + " Value:\n";
-		if ((!key.isNil() && key.isa() == ObjectMemory::clsSymbol &&
+		if ((key.isa() == ObjectMemory::clsSymbol &&
 			key.as<SymbolOop>()->strEquals("Super")))
 			std::cout << blanks(in + 2) << "<Super-entry>\n";
 		else
 			value.print(in + 2);
-
 		std::cout << blanks(in + 1) + "}\n";
-
-		for (link = *(AssociationLinkOop *)hp; !link.isNil();
-		     link = *(AssociationLinkOop *)hp) {
-			hp = (Oop *)link->vns();
-			key = *hp++;   /* link at: 1 */
-			value = *hp++; /* link at: 2 */
-			std::cout << blanks(in + 1) + "{ Key:\n";
-			key.print(in + 2);
-			std::cout << blanks(in + 1) + " Value:\n";
-			value.print(in + 2);
-			std::cout << blanks(in + 1) + "}\n";
-		}
 	}
 
 	std::cout << blanks(in) + "}\n";
@@ -488,12 +593,22 @@ void
 DictionaryOopDesc::symbolInsert(ObjectMemory &omem, SymbolOop key, Oop value)
 {
 	insert(omem, key.hashCode(), key, value);
+
+	/* code refers to globals by binding; keep any binding up to date */
+	if (DictionaryOop(this) == ObjectMemory::objGlobals) {
+		AssociationLinkOop binding = ObjectMemory::objGlobalBindings->
+		    symbolLookup(key).as<AssociationLinkOop>();
+
+		if (!binding.isNil())
+			binding->setTwo(value);
+	}
 }
 
 Oop
 DictionaryOopDesc::symbolLookup(SymbolOop aSymbol)
 {
-	return findPairByFun<Oop>(aSymbol->hashCode(), aSymbol, hashCmp).second;
+	return findPairByFun<Oop>(aSymbol->hashCode(), aSymbol, identityTest)
+	    .second;
 }
 
 Oop
@@ -528,9 +643,9 @@ strTest(Oop key, std::string aString)
 SymbolOop
 SymbolOopDesc::fromString(ObjectMemory &omem, std::string aString)
 {
+	int hash = strHash(aString);
 	SymbolOop newObj = ObjectMemory::objSymbolTable->
-	    findPairByFun(strHash(aString), aString,strTest).first.
-	    as<SymbolOop>();
+	    findPairByFun(hash, aString, strTest).first.as<SymbolOop>();
 
 	if (!newObj.isNil())
 		return newObj;
@@ -539,9 +654,10 @@ SymbolOopDesc::fromString(ObjectMemory &omem, std::string aString)
 	newObj = omem.newByteObj<SymbolOop>(aString.size() + 1);
 
 	newObj.setIsa(ObjectMemory::clsSymbol);
+	/* a symbol's hash code is its string's, so computed only once */
+	newObj->setHashCode(hash);
 	strncpy((char *)newObj->vns(), aString.c_str(), aString.size());
-	ObjectMemory::objSymbolTable->insert(omem, strHash(aString.c_str()),
-	    newObj, Oop());
+	ObjectMemory::objSymbolTable->insert(omem, hash, newObj, Oop());
 
 	return newObj;
 }
@@ -617,6 +733,7 @@ ProcessOopDesc::allocate(ObjectMemory &omem)
 	proc->setIsa(ObjectMemory::clsProcess);
 	proc->stack = ArrayOopDesc::newWithSize(omem, 2000000);
 	proc->bp = (intptr_t)1;
+	proc->priority = Smi((int64_t)SchedulerOopDesc::kDefaultPriority);
 	proc->stack->m_kind = kStack;
 	return proc;
 }
\ No newline at end of file
@@ -55,8 +55,38 @@ class AssociationLinkOopDesc : public OopOopDesc {
 	static AssociationLinkOop newWith(ObjectMemory &omem, Oop a, Oop b);
 };
 
+/**
+ * A hash table with open addressing. The table is an Array of entries of a
+ * key, its value, and the key's hash, kept so that the table can be grown
+ * without knowing how its keys were hashed, and so that probing need look at
+ * a key only when its hash matches. An entry with a nil key is empty. Entries
+ * are placed by linear probing, and the table, whose capacity is a power of
+ * two, doubles when three-quarters full. The Smalltalk side of Dictionary
+ * shares this layout.
+ */
 class DictionaryOopDesc : public OopOopDesc {
+	void grow(ObjectMemory &omem);
+
     public:
+	static const int clsNstLength = 2;
+	static const int kEntrySize = 3;
+
+	AccessorPair(ArrayOop, table, setTable, 0);
+	AccessorPair(Smi, tally, setTally, 1);
+
+	/**
+	 * Finds the entry for \p key under \p hash, or else the empty entry
+	 * where it would go. Keys are compared by identity; or if \p identity
+	 * is false, as Smalltalk's = would compare them, insofar as the VM can
+	 * tell: on meeting a key for which it can't, returns NULL.
+	 */
+	Oop *entryFor(uint32_t hash, Oop key, bool identity);
+	/** Fills in the empty \p entry, growing the table if it is due. */
+	void fillEntry(ObjectMemory &omem, Oop *entry, uint32_t hash, Oop key,
+	    Oop value);
+	/** Empties \p entry, moving back those which had probed past it. */
+	void removeEntry(Oop *entry);
+
 	/**
 	 * Inserts /a value under /a key under the hash /a hash.
 	 */
@@ -105,7 +135,8 @@ class DictionaryOopDesc : public OopOopDesc {
 
 #pragma mark creation
 
-	static DictionaryOop newWithSize(ObjectMemory &omem, size_t numBuckets);
+	/** Makes a dictionary with room for \p numEntries before growing. */
+	static DictionaryOop newWithSize(ObjectMemory &omem, size_t numEntries);
 
 #pragma mark misc
 	void print(int in);
@@ -354,8 +385,55 @@ public:
 	void *&vns() { return (void*&)m_bytes; }
 };
 
+/**
+ * An arbitrary-precision integer. The first word of the von Neumann space is
+ * the sign (non-zero if negative); the remainder is the magnitude, stored as
+ * 64-bit limbs with the least significant first.
+ *
+ * The arithmetic functions accept SmallIntegers and LongIntegers alike, and
+ * normalise their results: anything that fits in a SmallInteger is returned
+ * as one. They return nil if an operand is not an integer.
+ */
+class LongIntegerOopDesc : public ByteOopDesc {
+    public:
+	typedef uint64_t Limb;
+
+	/**
+	 * Operands of fewer limbs than this are multiplied by the schoolbook
+	 * method rather than by Karatsuba's.
+	 */
+	static const size_t karatsubaThreshold = 32;
+
+	bool isNegative() { return ((Limb *)m_bytes)[0]; }
+	size_t nLimbs() { return m_size / sizeof(Limb) - 1; }
+	Limb *limbs() { return (Limb *)m_bytes + 1; }
+
+	/**
+	 * Allocates a LongInteger of the given value. The result is never
+	 * normalised to a SmallInteger.
+	 */
+	static LongIntegerOop fromInt64(ObjectMemory &omem, int64_t value);
+
+	static bool isInteger(Oop oop);
+
+	static Oop add(ObjectMemory &omem, Oop a, Oop b);
+	static Oop sub(ObjectMemory &omem, Oop a, Oop b);
+	static Oop mul(ObjectMemory &omem, Oop a, Oop b);
+	/**
+	 * Divides \a a by \a b, truncating towards zero. The remainder, which
+	 * takes the sign of \a a, is placed into \a rem. Returns nil if \a b is
+	 * zero.
+	 */
+	static Oop quoRem(ObjectMemory &omem, Oop a, Oop b, Oop &rem);
+	/** Shifts left by \a shift bits, or right (flooring) if negative. */
+	static Oop bitShift(ObjectMemory &omem, Oop a, int64_t shift);
+	/** Returns -1, 0 or 1 as \a a is less than, equal to or above \a b. */
+	static int compare(Oop a, Oop b);
+	static std::string printString(Oop a, unsigned radix = 10);
+};
+
 class ProcessOopDesc : public OopOopDesc {
-	static const int clsNstLength = 8;
+	static const int clsNstLength = 11;
 
     public:
 	enum State {
@@ -373,6 +451,9 @@ class ProcessOopDesc : public OopOopDesc {
 	Oop accumulator;
 	Smi state;
 	AssociationLinkOop events;
+	ProcessOop prevLink; /**< predecessor in the run queue */
+	SchedulerOop runQueue; /**< scheduler whose run queue holds it, or nil */
+	Smi priority; /**< from 0, lowest, to SchedulerOopDesc::kPriorities - 1 */
 
 	static ProcessOop allocate(ObjectMemory &omem);
 
@@ -382,25 +463,44 @@ class ProcessOopDesc : public OopOopDesc {
 
 class SchedulerOopDesc : public OopOopDesc {
 	public:
-	static const int clstNstLength = 3;
+	static const int clstNstLength = 8;
+	static const int kPriorities = 8;
+	static const int kDefaultPriority = 4;
 
-	ProcessOop runnable;
+	/** head and tail of the run queue of each priority, lowest first */
+	ArrayOop runQueues;
 	ProcessOop waiting;
 	ProcessOop curProc;
+	Smi readyLevels; /**< bit n set if the run queue of priority n isn't empty */
+	/**
+	 * Processes parked on each fd: to read at fd * 2, to write at fd * 2 + 1.
+	 * Each slot heads a chain through ProcessOopDesc::link, which a parked
+	 * process does not otherwise use.
+	 */
+	ArrayOop ioWaits;
+	ArrayOop sleepers; /**< processes parked in CPUThreadPair::sleep() */
+	ArrayOop timers; /**< Timers armed by CPUThreadPair::startTimer() */
+	/** the process which signals the Semaphores of expired Timers */
+	ProcessOop timerService;
+
+	static SchedulerOop allocate(ObjectMemory &omem);
 
 	/**
-	 * Add a process to the runnable list. Process must NOT already be in
-	 * the list.
+	 * Add a process to the tail of the run queue of its priority. Process
+	 * must NOT already be in a run queue.
+	 *
+	 * @return Whether it outranks the current process, which it should
+	 * then preempt.
 	 */
-	void addProcToRunnables(ProcessOop proc);
+	bool addProcToRunnables(ProcessOop proc);
 	/**
 	 * Suspend the currently-running process. Places it into the #waiting
 	 * list.
 	 */
 	void suspendCurrentProcess();
 	/**
-	 * Get the next runnable process, moving it to the last position in
-	 * the runnable queue.
+	 * Take the next runnable process from the highest-priority non-empty
+	 * run queue.
 	 */
 	ProcessOop getNextForRunning();
 	/**
@@ -409,6 +509,31 @@ class SchedulerOopDesc : public OopOopDesc {
 	 * \pre proc is in the runnable list
 	 */
 	void suspendProcess(ProcessOop proc);
+	/**
+	 * Change the priority of a process, moving it to the run queue of
+	 * its new priority if it is in one.
+	 *
+	 * @return Whether it now outranks the current process.
+	 */
+	bool setPriority(ProcessOop proc, int priority);
+
+	/*
+	 * The run queues are doubly linked, through ProcessOopDesc::link and
+	 * ProcessOopDesc::prevLink, and each queued process refers back to its
+	 * scheduler; while readyLevels finds the highest non-empty queue with
+	 * a count of leading zeroes. So all of the above take constant time.
+	 */
+    private:
+	ProcessOop &head(int priority)
+	{
+		return runQueues->basicAt0(priority * 2).as<ProcessOop>();
+	}
+	ProcessOop &tail(int priority)
+	{
+		return runQueues->basicAt0(priority * 2 + 1).as<ProcessOop>();
+	}
+	bool outranksCurrent(ProcessOop proc);
+	void unlink(ProcessOop proc);
 };
 
 inline const char *
@@ -23,6 +23,9 @@ extern "C" {
 #define VT_isSmi(x) (VT_tag (x) == 1)
 #define VT_intValue(x) (((intptr_t)x) >> VT_tagBits)
 #define VT_fromInt(iVal) ((void *) (((iVal) << VT_tagBits) | 1))
+#define VT_smiMax ((INT64_C(1) << (63 - VT_tagBits)) - 1)
+#define VT_smiMin (-(INT64_C(1) << (63 - VT_tagBits)))
+#define VT_fitsSmi(iVal) ((iVal) >= VT_smiMin && (iVal) <= VT_smiMax)
 
 class ObjectMemory;
 
@@ -37,6 +40,7 @@ class ClassOopDesc;
 class ContextOopDesc;
 class DictionaryOopDesc;
 class FloatOopDesc;
+class LongIntegerOopDesc;
 class AssociationLinkOopDesc;
 class NativePointerOopDesc;
 class SmiOopDesc;
@@ -54,6 +58,7 @@ template <class T> class OopRef;
 typedef OopRef <OopDesc> 		Oop;
 typedef OopRef  <OopDesc>		Smi;
 typedef OopRef  <FloatOopDesc> 		FloatOop;
+typedef OopRef  <LongIntegerOopDesc>	LongIntegerOop;
 typedef OopRef  <MemOopDesc> 		MemOop;
 typedef OopRef   <OopOopDesc> 		OopOop;
 typedef OopRef    <ArrayOopDesc>	ArrayOop;
@@ -207,6 +212,10 @@ class MemOopDesc : public OopDesc {
 	 * Return the size of the object's von Neumann space in bytes/words/oops.
 	 */
 	size_t size() { return m_size; }
+	/** Return whether the object's von Neumann space holds bytes. */
+	bool isBytes() const { return m_kind == kBytes; }
+	/** Return whether the object's von Neumann space holds Oops. */
+	bool isOops() const { return m_kind == kOops; }
 	inline ClassOop &isa() { return m_isa; }
 	inline ClassOop &setIsa(ClassOop oop) { return m_isa = oop; }
 
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <fstream>
 #include <list>
+#include <stdexcept>
 #include <filesystem>
 
 #define YY_NO_UNISTD_H
@@ -79,6 +80,10 @@ ProgramNode * MVST_Parser::parseFile (std::string fName)
 	parser->parse(TOK_EOF);
 	parser->parse(0);
 
+	/* the errors themselves were reported by the syntax error handler */
+	if (parser->program == nullptr)
+		throw std::runtime_error("could not parse " + fName);
+
 	return parser->program;
 }
 
@@ -0,0 +1,490 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "Generation.hh"
+#include "Interpreter.hh"
+
+/**
+ * \defgroup Peephole Bytecode peephole optimiser
+ *
+ * CodeGen emits bytecode in a single tree walk, which leaves behind redundant
+ * sequences: stores immediately reloaded, jumps to jumps where inlined blocks
+ * nest, loads whose value is never used, and code following a return. After
+ * generation, the bytecode of each method and block is decoded into a list of
+ * instructions, whose jumps refer to the instruction they target; rules are
+ * applied to that list until none fires; and it is re-encoded.
+ *
+ * @{
+ */
+
+bool CodeGen::dumpBytecode = false;
+
+struct Instr {
+	Op::Opcode op;
+	std::vector<unsigned> operands; /**< excepting any jump offset */
+	size_t target;                 /**< index of the target, for jumps */
+	bool dead = false;
+};
+
+static bool
+isConditionalJump(Op::Opcode op)
+{
+	return op == Op::kBranchIfFalse || op == Op::kBranchIfTrue ||
+	    op == Op::kBranchIfNil || op == Op::kBranchIfNotNil;
+}
+
+static bool
+isJump(Op::Opcode op)
+{
+	return op == Op::kJump || isConditionalJump(op);
+}
+
+static bool
+isReturn(Op::Opcode op)
+{
+	return op == Op::kReturn || op == Op::kReturnSelf ||
+	    op == Op::kBlockReturn;
+}
+
+/** Whether control never passes from this instruction to the next. */
+static bool
+endsFlow(Op::Opcode op)
+{
+	return op == Op::kJump || isReturn(op);
+}
+
+/**
+ * Whether this instruction does nothing but set the accumulator, so that it
+ * may be removed if the accumulator is set again before being read.
+ */
+static bool
+isPureLoad(Op::Opcode op)
+{
+	switch (op) {
+	case Op::kLdaNil:
+	case Op::kLdaTrue:
+	case Op::kLdaFalse:
+	case Op::kLdaThisProcess:
+	case Op::kLdaSmalltalk:
+	case Op::kLdaParentHeapVar:
+	case Op::kLdaMyHeapVar:
+	case Op::kLdaGlobal:
+	case Op::kLdaNstVar:
+	case Op::kLdaLiteral:
+	case Op::kLdaCleanBlock:
+	case Op::kLdar:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Whether this instruction sets the accumulator without reading it.
+ */
+static bool
+overwritesAc(Op::Opcode op)
+{
+	return isPureLoad(op) || op == Op::kLdaBlockCopy ||
+	    op == Op::kLdaBlockCopyCapturing || op == Op::kPrimitive0;
+}
+
+/**
+ * Returns the number of operands (other than any jump offset) of \p op; for
+ * those followed by a register list, not counting the list.
+ */
+static size_t
+operandCount(Op::Opcode op)
+{
+	switch (op) {
+	case Op::kLdaNil:
+	case Op::kLdaTrue:
+	case Op::kLdaFalse:
+	case Op::kLdaThisContext:
+	case Op::kLdaThisProcess:
+	case Op::kLdaSmalltalk:
+	case Op::kJump:
+	case Op::kBranchIfFalse:
+	case Op::kBranchIfTrue:
+	case Op::kBranchIfNil:
+	case Op::kBranchIfNotNil:
+	case Op::kReturnSelf:
+	case Op::kReturn:
+	case Op::kBlockReturn:
+	case Op::kLdaClassOf:
+	case Op::kIsNil:
+	case Op::kNotNil:
+		return 0;
+
+	case Op::kLdaParentHeapVar:
+	case Op::kLdaMyHeapVar:
+	case Op::kLdaGlobal:
+	case Op::kLdaNstVar:
+	case Op::kLdaLiteral:
+	case Op::kLdaBlockCopy:
+	case Op::kLdaCleanBlock:
+	case Op::kLdar:
+	case Op::kStaNstVar:
+	case Op::kStaGlobal:
+	case Op::kStaParentHeapVar:
+	case Op::kStaMyHeapVar:
+	case Op::kStar:
+	case Op::kAnd:
+	case Op::kIdentEq:
+	case Op::kPrimitive0:
+	case Op::kPrimitive1:
+		return 1;
+
+	case Op::kMoveParentHeapVarToMyHeapVars:
+	case Op::kMoveMyHeapVarToParentHeapVars:
+	case Op::kMove:
+	case Op::kBinOp:
+	case Op::kPrimitive2:
+	case Op::kPrimitive3:
+	/* literal, count, then count registers */
+	case Op::kLdaBlockCopyCapturing:
+	case Op::kSend:
+	case Op::kSendSuper:
+		return 2;
+
+	case Op::kPrimitiveV:
+		return 3;
+
+	default:
+		break;
+	}
+
+	std::cerr << "Unknown opcode " << unsigned(op) << "\n";
+	abort();
+}
+
+static bool
+hasRegisterList(Op::Opcode op)
+{
+	return op == Op::kLdaBlockCopyCapturing || op == Op::kSend ||
+	    op == Op::kSendSuper;
+}
+
+static std::vector<Instr>
+decode(const std::vector<uint8_t> &code)
+{
+	std::vector<Instr> instrs;
+	std::vector<size_t> offsets;    /* byte offset of each instruction */
+	size_t pc = 0;
+
+	while (pc < code.size()) {
+		Instr instr;
+		bool wide = code[pc] == Op::kWide;
+		size_t nOperands;
+
+		offsets.push_back(pc);
+		if (wide)
+			pc++;
+		instr.op = (Op::Opcode)code[pc++];
+		nOperands = operandCount(instr.op);
+
+		for (size_t i = 0; i < nOperands; i++) {
+			if (wide) {
+				instr.operands.push_back((code[pc] << 8) |
+				    code[pc + 1]);
+				pc += 2;
+			} else
+				instr.operands.push_back(code[pc++]);
+
+			if (i == 1 && hasRegisterList(instr.op))
+				nOperands += instr.operands[1];
+		}
+
+		if (isJump(instr.op)) {
+			int16_t offs = (code[pc] << 8) | code[pc + 1];
+			pc += 2;
+			instr.target = pc + offs; /* as offset; mapped below */
+		}
+
+		instrs.push_back(instr);
+	}
+	offsets.push_back(pc);
+
+	for (auto &instr : instrs)
+		if (isJump(instr.op))
+			instr.target = std::lower_bound(offsets.begin(),
+			    offsets.end(), instr.target) - offsets.begin();
+
+	return instrs;
+}
+
+static std::vector<uint8_t>
+encode(const std::vector<Instr> &instrs)
+{
+	std::vector<uint8_t> code;
+	std::vector<size_t> offsets;
+
+	for (auto &instr : instrs) {
+		bool wide = std::any_of(instr.operands.begin(),
+		    instr.operands.end(),
+		    [](unsigned operand) { return operand > UINT8_MAX; });
+
+		offsets.push_back(code.size());
+		if (wide)
+			code.push_back(Op::kWide);
+		code.push_back(instr.op);
+		for (auto operand : instr.operands) {
+			if (wide)
+				code.push_back(operand >> 8);
+			code.push_back(operand & 0xff);
+		}
+		if (isJump(instr.op)) {
+			code.push_back(0);
+			code.push_back(0);
+		}
+	}
+	offsets.push_back(code.size());
+
+	for (size_t i = 0; i < instrs.size(); i++)
+		if (isJump(instrs[i].op)) {
+			size_t end = offsets[i + 1];
+			ssize_t offs = ssize_t(offsets[instrs[i].target]) -
+			    ssize_t(end);
+
+			if (offs != int16_t(offs))
+				throw std::runtime_error("Jump too long for "
+				    "bytecode");
+
+			code[end - 2] = uint16_t(offs) >> 8;
+			code[end - 1] = uint16_t(offs) & 0xff;
+		}
+
+	return code;
+}
+
+/**
+ * Drops instructions marked dead, redirecting jumps to a dead instruction to
+ * the first live one following it.
+ */
+static void
+compact(std::vector<Instr> &instrs)
+{
+	std::vector<size_t> newIndex(instrs.size() + 1);
+	std::vector<Instr> live;
+
+	for (size_t i = 0; i <= instrs.size(); i++) {
+		newIndex[i] = live.size();
+		if (i < instrs.size() && !instrs[i].dead)
+			live.push_back(instrs[i]);
+	}
+
+	for (auto &instr : live)
+		if (isJump(instr.op))
+			instr.target = newIndex[instr.target];
+
+	instrs = live;
+}
+
+/** Marks unreachable instructions dead. */
+static bool
+removeUnreachable(std::vector<Instr> &instrs)
+{
+	std::vector<bool> reached(instrs.size(), false);
+	std::vector<size_t> work = { 0 };
+	bool changed = false;
+
+	while (!work.empty()) {
+		size_t i = work.back();
+
+		work.pop_back();
+		if (i >= instrs.size() || reached[i])
+			continue;
+		reached[i] = true;
+
+		if (isJump(instrs[i].op))
+			work.push_back(instrs[i].target);
+		if (!endsFlow(instrs[i].op))
+			work.push_back(i + 1);
+	}
+
+	for (size_t i = 0; i < instrs.size(); i++)
+		if (!reached[i]) {
+			instrs[i].dead = true;
+			changed = true;
+		}
+
+	return changed;
+}
+
+/**
+ * Follows a jump from \p i to its final destination. A jump to an unconditional
+ * jump goes to the latter's target; a conditional jump to another testing the
+ * same thing (the accumulator being unchanged) goes wherever that one would.
+ */
+static size_t
+threadJump(const std::vector<Instr> &instrs, size_t i)
+{
+	Op::Opcode op = instrs[i].op;
+	size_t target = instrs[i].target;
+
+	/* bounded, lest jumps form a cycle */
+	for (int hops = 0; hops < 16 && target < instrs.size(); hops++) {
+		const Instr &next = instrs[target];
+
+		if (next.op == Op::kJump)
+			target = next.target;
+		else if (next.op == op)
+			target = next.target;
+		else if ((op == Op::kBranchIfTrue && next.op ==
+			     Op::kBranchIfFalse) ||
+		    (op == Op::kBranchIfFalse && next.op == Op::kBranchIfTrue) ||
+		    (op == Op::kBranchIfNil && next.op ==
+			Op::kBranchIfNotNil) ||
+		    (op == Op::kBranchIfNotNil && next.op == Op::kBranchIfNil))
+			target = target + 1;
+		else
+			break;
+	}
+
+	return target;
+}
+
+static Op::Opcode
+invertedBranch(Op::Opcode op)
+{
+	switch (op) {
+	case Op::kBranchIfFalse:
+		return Op::kBranchIfTrue;
+	case Op::kBranchIfTrue:
+		return Op::kBranchIfFalse;
+	case Op::kBranchIfNil:
+		return Op::kBranchIfNotNil;
+	default:
+		return Op::kBranchIfNil;
+	}
+}
+
+/** Applies the peephole rules once. Returns whether any fired. */
+static bool
+peephole(std::vector<Instr> &instrs)
+{
+	std::vector<bool> isTarget(instrs.size() + 1, false);
+	bool changed = false;
+
+	for (auto &instr : instrs)
+		if (isJump(instr.op))
+			isTarget[instr.target] = true;
+
+	for (size_t i = 0; i < instrs.size(); i++) {
+		Instr &instr = instrs[i];
+		Instr *next = i + 1 < instrs.size() ? &instrs[i + 1] : NULL;
+
+		if (instr.dead)
+			continue;
+
+		if (isJump(instr.op)) {
+			size_t target = threadJump(instrs, i);
+
+			if (target != instr.target) {
+				instr.target = target;
+				changed = true;
+			}
+
+			/* jump to the next instruction */
+			if (instr.target == i + 1) {
+				instr.dead = true;
+				changed = true;
+				continue;
+			}
+
+			/* unconditional jump to a return: just return */
+			if (instr.op == Op::kJump &&
+			    instr.target < instrs.size() &&
+			    isReturn(instrs[instr.target].op)) {
+				instr = instrs[instr.target];
+				changed = true;
+				continue;
+			}
+		}
+
+		if (next == NULL || next->dead)
+			continue;
+
+		/* Star rN; Ldar rN -> Star rN */
+		if (instr.op == Op::kStar && next->op == Op::kLdar &&
+		    instr.operands == next->operands && !isTarget[i + 1]) {
+			next->dead = true;
+			changed = true;
+		}
+
+		/* Ldar rN; Star rN -> Ldar rN */
+		else if (instr.op == Op::kLdar && next->op == Op::kStar &&
+		    instr.operands == next->operands && !isTarget[i + 1]) {
+			next->dead = true;
+			changed = true;
+		}
+
+		/* a load whose value is overwritten at once */
+		else if (isPureLoad(instr.op) && overwritesAc(next->op)) {
+			instr.dead = true;
+			changed = true;
+		}
+
+		/*
+		 * IsNil; BranchIfTrue L -> BranchIfNil L, and so on, where the
+		 * Boolean is overwritten unread whether the branch is taken or
+		 * not
+		 */
+		else if ((instr.op == Op::kIsNil || instr.op == Op::kNotNil) &&
+		    (next->op == Op::kBranchIfTrue ||
+			next->op == Op::kBranchIfFalse) &&
+		    !isTarget[i + 1] && i + 2 < instrs.size() &&
+		    !instrs[i + 2].dead && overwritesAc(instrs[i + 2].op) &&
+		    next->target < instrs.size() &&
+		    !instrs[next->target].dead &&
+		    overwritesAc(instrs[next->target].op)) {
+			next->op = (instr.op == Op::kIsNil) ==
+				(next->op == Op::kBranchIfTrue) ?
+			    Op::kBranchIfNil : Op::kBranchIfNotNil;
+			instr.dead = true;
+			changed = true;
+		}
+
+		/* BranchIfX L1; Jump L2; L1: -> BranchIfNotX L2 */
+		else if (isConditionalJump(instr.op) && next->op == Op::kJump &&
+		    instr.target == i + 2 && !isTarget[i + 1]) {
+			instr.op = invertedBranch(instr.op);
+			instr.target = next->target;
+			next->dead = true;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+void
+CodeGen::optimise(std::string name)
+{
+	std::vector<Instr> instrs;
+	bool changed;
+
+	if (dumpBytecode) {
+		std::cout << "Bytecode of " << name << " before optimisation:\n";
+		disassemble(m_bytecode.data(), m_bytecode.size());
+	}
+
+	instrs = decode(m_bytecode);
+	do {
+		changed = removeUnreachable(instrs);
+		changed |= peephole(instrs);
+		compact(instrs);
+	} while (changed);
+	m_bytecode = encode(instrs);
+
+	if (dumpBytecode) {
+		std::cout << "Bytecode of " << name << " after optimisation:\n";
+		disassemble(m_bytecode.data(), m_bytecode.size());
+	}
+}
+
+/**
+ * @}
+ */
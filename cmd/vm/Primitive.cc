@@ -1,7 +1,20 @@
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cmath>
 #include <csetjmp>
 #include <cstdint>
+#include <functional>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "CPUThread.hh"
 #include "Interpreter.hh"
@@ -12,7 +25,7 @@
 extern int64_t nextPid;
 
 Oop
-unsupportedPrim(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+unsupportedPrim(ObjectMemory &omem, ProcessOop &proc)
 {
 	return (Oop::nil());
 }
@@ -23,7 +36,7 @@ Always fails.
 Called from Scheduler>>initialize
 */
 Oop
-primAvailCount(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primAvailCount(ObjectMemory &omem, ProcessOop &proc)
 {
 	// fprintf (stderr, "free: %d\n", availCount ());
 	return (Oop::nil());
@@ -36,7 +49,7 @@ Called from
   Random>>randInteger:
 */
 Oop
-primRandom(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primRandom(ObjectMemory &omem, ProcessOop &proc)
 {
 	short i;
 	/* this is hacked because of the representation */
@@ -56,7 +69,7 @@ Returns the Boolean representation of the switch value after the invert.
 Called from Smalltalk>>watch
 */
 Oop
-primFlipWatching(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFlipWatching(ObjectMemory &omem, ProcessOop &proc)
 {
 	/* fixme */
 	bool watching = !watching;
@@ -69,12 +82,12 @@ Changes the current context to argsAt: 1, pushing argsAt: 2 to the top of the
 stack.
 */
 Oop
-primReturnInto(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primReturnInto(ObjectMemory &omem, ProcessOop &proc, Oop ctx, Oop value)
 {
 	/* FIXME: this is ugly */
 	#if 0
-	ContextOop ctx = args->basicAt(1).as<ContextOop>();
-	Oop rVal = args->basicAt(2);
+	ContextOop ctx = ctx.as<ContextOop>();
+	Oop rVal = value;
 	proc->context = ctx;
 	#endif
 	abort();
@@ -93,7 +106,7 @@ Never returns.
 Not called from the image.
 */
 Oop
-primExit(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primExit(ObjectMemory &omem, ProcessOop &proc)
 {
 	exit(0);
 }
@@ -103,9 +116,9 @@ Returns the class of which the receiver is an instance.
 Called from Object>>class
 */
 Oop
-primClass(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primClass(ObjectMemory &omem, ProcessOop &proc, Oop obj)
 {
-	return (args->basicAt(1).isa());
+	return (obj.isa());
 }
 
 /*
@@ -126,12 +139,12 @@ Returns a hashed representation of the receiver.
 Called from Object>>hash
 */
 Oop
-primHash(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primHash(ObjectMemory &omem, ProcessOop &proc, Oop obj)
 {
-	if (args->basicAt(1).isSmi())
-		return (args->basicAt(1));
+	if (obj.isSmi())
+		return (obj);
 	else
-		return (Smi(args->basicAt(1).hashCode()));
+		return (Smi(obj.hashCode()));
 }
 
 /*
@@ -148,7 +161,7 @@ context which invokes this primitive.  Only then is the process stack
 change effective.
 */
 Oop
-primBlockReturn(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primBlockReturn(ObjectMemory &omem, ProcessOop &proc, Oop ctx)
 {
 	int i;
 	int j;
@@ -157,8 +170,8 @@ primBlockReturn(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
 	// first get previous link pointer
 	i = smiOf (orefOf (processStack, linkPointer).val);
 	// then creating context pointer
-	j = smiOf (orefOf (args->basicAt (1)->ptr, 1).val);
-	if (ptrNe (orefOf (processStack, j + 1), args->basicAt (1)))
+	j = smiOf (orefOf (ctx->ptr, 1).val);
+	if (ptrNe (orefOf (processStack, j + 1), ctx))
 	    return ((Oop)ObjectMemory::objFalse);
 	// first change link pointer to that of creator
 	orefOfPut (processStack, i, orefOf (processStack, j));
@@ -188,7 +201,7 @@ Returns true in the former case; false in the latter.
 Called from Process>>execute
 */
 Oop
-primExecute(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primExecute(ObjectMemory &omem, ProcessOop &proc, Oop aProc)
 {
 	/*encPtr saveProcessStack;
 	int saveLinkPointer;
@@ -202,7 +215,7 @@ primExecute(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
 	signal (SIGINT, brkfun);
 	if (setjmp (jb))
 	    returnedObject = (Oop)ObjectMemory::objFalse;
-	else if (execute (args->basicAt (1)->ptr, 1 << 12))
+	else if (execute (aProc->ptr, 1 << 12))
 	    returnedObject = (Oop)ObjectMemory::objTrue;
 	else
 	    returnedObject = (Oop)ObjectMemory::objFalse;
@@ -220,9 +233,9 @@ of the first argument's; false otherwise.
 Called from Object>>==
 */
 Oop
-primIdent(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primIdent(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (args->basicAt(1) == args->basicAt(2))
+	if (a == b)
 		return ((Oop)ObjectMemory::objTrue);
 	else
 		return ((Oop)ObjectMemory::objFalse);
@@ -256,11 +269,11 @@ Called from
   Symbol>>asString
 */
 Oop
-primStringCat(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primStringCat(ObjectMemory &omem, ProcessOop &proc, Oop string1, Oop string2)
 {
-	uint8_t *src1 = args->basicAt(1).as<StringOop>()->vns();
+	uint8_t *src1 = string1.as<StringOop>()->vns();
 	size_t len1 = strlen((char *)src1);
-	uint8_t *src2 = args->basicAt(2).as<StringOop>()->vns();
+	uint8_t *src2 = string2.as<StringOop>()->vns();
 	size_t len2 = strlen((char *)src2);
 	StringOop ans = omem.newByteObj<StringOop>(len1 + len2 + 1);
 	uint8_t *tgt = ans->vns();
@@ -321,11 +334,11 @@ Returns the receiver.
 Called from Symbol>>assign:
 */
 Oop
-primSymbolAssign(ObjectMemory &omem, ProcessOop proc, ArrayOop args) /*fix*/
+primSymbolAssign(ObjectMemory &omem, ProcessOop &proc, Oop symbol, Oop value) /*fix*/
 {
 	ObjectMemory::objGlobals->symbolInsert(omem,
-	    args->basicAt(1).as<SymbolOop>(), args->basicAt(2));
-	return (args->basicAt(1));
+	    symbol.as<SymbolOop>(), value);
+	return (symbol);
 }
 
 /*
@@ -390,40 +403,39 @@ Returns the new String.
 Called from String>>copyFrom:to:
 */
 Oop
-primCopyFromTo(ObjectMemory &omem, ProcessOop proc, ArrayOop args) /*fix*/
+primCopyFromTo(ObjectMemory &omem, ProcessOop &proc, Oop string,
+    Oop position1, Oop position2)
 {
-	if ((!args->basicAt(2).isSmi() || (!args->basicAt(3).isSmi())))
-		perror("#copyFromTo: non integer index");
-	{
-		uint8_t *src = args->basicAt(1).as<StringOop>()->vns();
-		size_t len = strlen((char *)src);
-		int pos1 = args->basicAt(2).as<Smi>().smi();
-		int pos2 = args->basicAt(3).as<Smi>().smi();
-		int req = pos2 + 1 - pos1;
-		size_t act;
-		StringOop ans;
-		uint8_t *tgt;
-		if (pos1 >= 1 && pos1 <= len && req >= 1)
-			act = min(req, strlen(((char *)src) + (pos1 - 1)));
-		else
-			act = 0;
-		ans = omem.newByteObj<StringOop>(act + 1);
-		tgt = ans->vns();
-		(void)memcpy(tgt, src + (pos1 - 1), act);
-		ans.setIsa(ObjectMemory::clsString);
-		return ((Oop)ans);
-	}
+	uint8_t *src = string.as<StringOop>()->vns();
+	size_t len = strlen((char *)src);
+	intptr_t pos1, req;
+	size_t act;
+	StringOop ans;
+
+	if (!position1.isSmi() || !position2.isSmi())
+		return Oop::nil();
+
+	pos1 = position1.smi();
+	req = position2.smi() + 1 - pos1;
+	if (pos1 >= 1 && pos1 <= len && req >= 1)
+		act = min(req, strnlen((char *)src + (pos1 - 1), len - (pos1 - 1)));
+	else
+		act = 0;
+	ans = omem.newByteObj<StringOop>(act + 1);
+	(void)memcpy(ans->vns(), src + (pos1 - 1), act);
+	ans.setIsa(ObjectMemory::clsString);
+	return ans;
 }
 
 Oop
-primParse(ObjectMemory &omem, ProcessOop proc, ArrayOop args) /*del*/
+primParse(ObjectMemory &omem, ProcessOop &proc, Oop cls, Oop text) /*del*/
 {
-	/*setInstanceVariables (args->basicAt(1)->ptr);
-	if (parse (args->basicAt(2)->ptr, (char *)vnsOf
-	(args->basicAt(2)->ptr), false))
+	/*setInstanceVariables (cls->ptr);
+	if (parse (text->ptr, (char *)vnsOf
+	(text->ptr), false))
 	{
-	    flushCache (orefOf (args->basicAt(2)->ptr, messageInMethod).ptr,
-	args->basicAt(1)->ptr); return ((Oop)memMgr.objTrue());
+	    flushCache (orefOf (text->ptr, messageInMethod).ptr,
+	cls->ptr); return ((Oop)memMgr.objTrue());
 	}
 	else
 	    return ((Oop)memMgr.objFalse());*/
@@ -435,29 +447,27 @@ representation.
 Called from Integer>>asFloat
 */
 Oop
-primAsFloat(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primAsFloat(ObjectMemory &omem, ProcessOop &proc, Oop smi)
 {
-	if (!args->basicAt(1).isSmi())
+	if (!smi.isSmi())
 		return (Oop::nil());
-	return (args->basicAt(1)); // FIXME:(Oop)FloatOop((double)args->basicAt
+	return (smi); // FIXME:(Oop)FloatOop((double)args->basicAt
 				   // (1).as<SmiOop> ().smi ()));
 }
 
 /*
-Defines a counter to be the argument's value.  When this counter is
-less than 1, a Process time slice is finished.
-Always fails.
-Called from
-  Scheduler>>critical:
-  Scheduler>>yield
+Sets the timeslice quantum to the argument, a number of milliseconds; 0
+selects the adaptive quantum.
+Returns the previous setting, or nil if the argument is not a non-negative
+SmallInteger.
+Called from VM class>>timeSlice:
 */
 Oop
-primSetTimeSlice(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primSetTimeSlice(ObjectMemory &omem, ProcessOop &proc, Oop ms)
 {
-	/*FIXME: if (!args->basicAt (1).isSmi ()))
-	    return (Oop::nil ());
-	*counterAddress = args->basicAt (1).as<SmiOop> ().smi ();*/
-	return (Oop::nil());
+	if (!ms.isSmi() || ms.smi() < 0 || ms.smi() > INT_MAX)
+		return (Oop::nil());
+	return (Smi((int64_t)CPUThreadPair::setTimeSlice(ms.smi())));
 }
 
 /*
@@ -491,6 +501,81 @@ primAllocByteObj(ObjectMemory &omem, ProcessOop &proc, Oop size)
 	return (omem.newByteObj<MemOop>(size.as<Smi>().smi()));
 }
 
+/**
+ * \defgroup SmallInteger arithmetic
+ * Overflow is detected by the compiler builtins on the operands shifted up by
+ * the tag width, so that 64-bit overflow coincides exactly with leaving the
+ * SmallInteger range. Overflowing results, and operations where either
+ * operand is a LongInteger, are computed natively by LongIntegerOopDesc.
+ * Operations on any other kind of operand fail (returning nil), which sends
+ * the corresponding message instead.
+ * @{
+ */
+
+/**
+ * Returns \p a shifted up by the tag width. The shift is done unsigned, as
+ * left-shifting a negative value is undefined.
+ */
+static inline int64_t
+smiShiftUp(int64_t a)
+{
+	return (int64_t)((uint64_t)a << VT_tagBits);
+}
+
+static inline bool
+smiAddOverflow(int64_t a, int64_t b, int64_t &result)
+{
+	int64_t r;
+	if (__builtin_add_overflow(smiShiftUp(a), smiShiftUp(b), &r))
+		return true;
+	result = r >> VT_tagBits;
+	return false;
+}
+
+static inline bool
+smiSubOverflow(int64_t a, int64_t b, int64_t &result)
+{
+	int64_t r;
+	if (__builtin_sub_overflow(smiShiftUp(a), smiShiftUp(b), &r))
+		return true;
+	result = r >> VT_tagBits;
+	return false;
+}
+
+static inline bool
+smiMulOverflow(int64_t a, int64_t b, int64_t &result)
+{
+	int64_t r;
+	if (__builtin_mul_overflow(a, smiShiftUp(b), &r))
+		return true;
+	result = r >> VT_tagBits;
+	return false;
+}
+
+/**
+ * Returns the result of comparing two integers as a Boolean according to
+ * \a pred, or nil if either is not an integer.
+ */
+template <typename Pred>
+static inline Oop
+intCompare(Oop a, Oop b, Pred pred)
+{
+	int cmp;
+
+	if (a.isSmi() && b.isSmi())
+		cmp = (a.smi() > b.smi()) - (a.smi() < b.smi());
+	else if (LongIntegerOopDesc::isInteger(a) &&
+	    LongIntegerOopDesc::isInteger(b))
+		cmp = LongIntegerOopDesc::compare(a, b);
+	else
+		return (Oop::nil());
+
+	if (pred(cmp, 0))
+		return ((Oop)ObjectMemory::objTrue);
+	else
+		return ((Oop)ObjectMemory::objFalse);
+}
+
 /*
 Returns the result of adding the argument's value to the receiver's
 value.
@@ -500,17 +585,11 @@ Also called for SendBinary bytecodes.
 Oop
 primAdd(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	long longresult;
+	int64_t result;
 
-	if (!a.isSmi() || !b.isSmi()) {
-		return (Oop::nil());
-	}
-	longresult = a.as<Smi>().smi();
-	longresult += b.as<Smi>().smi();
-	if (longresult < INT64_MAX / 2) // FIXME: bounds test SMI
-		return (Smi(longresult));
-	else
-		return (Oop::nil());
+	if (a.isSmi() && b.isSmi() && !smiAddOverflow(a.smi(), b.smi(), result))
+		return (Smi(result));
+	return (LongIntegerOopDesc::add(omem, a, b));
 }
 
 /*
@@ -522,15 +601,11 @@ Also called for SendBinary bytecodes.
 Oop
 primSubtract(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	long longresult;
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	longresult = a.as<Smi>().smi();
-	longresult -= b.as<Smi>().smi();
-	if (longresult < INT64_MAX / 2) // FIXME: smi boundcheck
-		return (Smi(longresult));
-	else
-		return (Oop::nil());
+	int64_t result;
+
+	if (a.isSmi() && b.isSmi() && !smiSubOverflow(a.smi(), b.smi(), result))
+		return (Smi(result));
+	return (LongIntegerOopDesc::sub(omem, a, b));
 }
 
 /*
@@ -542,13 +617,7 @@ Also called for SendBinary bytecodes.
 Oop
 primLessThan(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	if (a.as<Smi>().smi() <
-	    b.as<Smi>().smi())
-		return ((Oop)ObjectMemory::objTrue);
-	else
-		return ((Oop)ObjectMemory::objFalse);
+	return intCompare(a, b, std::less<int>());
 }
 
 /*
@@ -560,13 +629,7 @@ Also called for SendBinary bytecodes.
 Oop
 primGreaterThan(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	if (a.as<Smi>().smi() >
-	    b.as<Smi>().smi())
-		return ((Oop)ObjectMemory::objTrue);
-	else
-		return ((Oop)ObjectMemory::objFalse);
+	return intCompare(a, b, std::greater<int>());
 }
 
 /*
@@ -577,13 +640,7 @@ Called for SendBinary bytecodes.
 Oop
 primLessOrEqual(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	if (a.as<Smi>().smi() <=
-	    b.as<Smi>().smi())
-		return ((Oop)ObjectMemory::objTrue);
-	else
-		return ((Oop)ObjectMemory::objFalse);
+	return intCompare(a, b, std::less_equal<int>());
 }
 
 /*
@@ -594,30 +651,19 @@ Called for SendBinary bytecodes.
 Oop
 primGreaterOrEqual(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	if (a.as<Smi>().smi() >=
-	    b.as<Smi>().smi())
-		return ((Oop)ObjectMemory::objTrue);
-	else
-		return ((Oop)ObjectMemory::objFalse);
+	return intCompare(a, b, std::greater_equal<int>());
 }
 
 /*
 Returns true if the receiver's value is equal to the argument's value;
 false otherwise.
-Called for SendBinary bytecodes.
+Called from Integer>>=
+Also called for SendBinary bytecodes.
 */
 Oop
 primEqual(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	if (a.as<Smi>().smi() ==
-	    b.as<Smi>().smi())
-		return ((Oop)ObjectMemory::objTrue);
-	else
-		return ((Oop)ObjectMemory::objFalse);
+	return intCompare(a, b, std::equal_to<int>());
 }
 
 /*
@@ -628,13 +674,7 @@ Called for SendBinary bytecodes.
 Oop
 primNotEqual(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	if (a.as<Smi>().smi() !=
-	    b.as<Smi>().smi())
-		return ((Oop)ObjectMemory::objTrue);
-	else
-		return ((Oop)ObjectMemory::objFalse);
+	return intCompare(a, b, std::not_equal_to<int>());
 }
 
 /*
@@ -646,63 +686,54 @@ Also called for SendBinary bytecodes.
 Oop
 primMultiply(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	long longresult;
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	longresult = a.as<Smi>().smi();
-	longresult *= b.as<Smi>().smi();
-	if (longresult < INT64_MAX / 2) // FIXME: boundscheck smi
-		return (Smi(longresult));
-	else
-		return (Oop::nil());
+	int64_t result;
+
+	if (a.isSmi() && b.isSmi() && !smiMulOverflow(a.smi(), b.smi(), result))
+		return (Smi(result));
+	return (LongIntegerOopDesc::mul(omem, a, b));
 }
 
 /*
 Returns the quotient of the result of dividing the receiver's value by
-the argument's value.
+the argument's value, truncated towards zero.  Fails if the argument is
+zero.
 Called from Integer>>quo:
 Also called for SendBinary bytecodes.
 */
 Oop
 primQuotient(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	long longresult;
-	if (!a.isSmi() || !b.isSmi())
-		return (Oop::nil());
-	if (b.as<Smi>().smi() == 0)
-		return (Oop::nil());
-	longresult = a.as<Smi>().smi();
-	longresult /= b.as<Smi>().smi();
-	if (1) // FIXME: boundscheck 1) // FIXME: boundscheck smi
-		return (Smi(longresult));
-	else
-		return (Oop::nil());
+	Oop rem;
+
+	if (a.isSmi() && b.isSmi()) {
+		if (b.smi() == 0)
+			return (Oop::nil());
+		/* only SmallInteger minimum quo: -1 can leave the range */
+		if (VT_fitsSmi(a.smi() / b.smi()))
+			return (Smi(a.smi() / b.smi()));
+	}
+	return (LongIntegerOopDesc::quoRem(omem, a, b, rem));
 }
 
 /*
 Returns the remainder of the result of dividing the receiver's value by
-the argument's value.
-Called for SendBinary bytecodes.
+the argument's value.  Fails if the argument is zero.
+Called from Integer>>rem:
+Also called for SendBinary bytecodes.
 */
 Oop
 primRemainder(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	long longresult;
+	Oop rem;
 
-	if (!a.isSmi() || !b.isSmi()) {
-		printf("#primRem: receiver or arg not integer");
-		return (Oop::nil());
+	if (a.isSmi() && b.isSmi()) {
+		if (b.smi() == 0)
+			return (Oop::nil());
+		return (Smi(a.smi() % b.smi()));
 	}
-	if (b.as<Smi>().smi() == 0) {
-		printf("#primRem: division by zero");
-		return (Oop::nil());
-	}
-	longresult = a.as<Smi>().smi();
-	longresult %= b.as<Smi>().smi();
-	if (1) // FIXME: boundscheck smi
-		return (Smi(longresult));
-	else
+	if (LongIntegerOopDesc::quoRem(omem, a, b, rem).isNil())
 		return (Oop::nil());
+	return (rem);
 }
 
 /*
@@ -742,33 +773,45 @@ primBitXor(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 /*
 Returns the result of shifting the receiver's value a number of bit
 positions denoted by the argument's value.  Positive arguments cause
-left shifts.  Negative arguments cause right shifts.  Note that the
-result is truncated to the range of embeddable values.
-Called from Integer>>bitXor:
+left shifts.  Negative arguments cause right shifts, rounding towards
+negative infinity.
+Called from Integer>>bitShift:
 */
 Oop
-primBitShift(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primBitShift(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	long longresult;
-	if (!args->basicAt(1).isSmi() || !args->basicAt(2).isSmi())
+	int64_t val, shift;
+
+	if (!b.isSmi())
 		return (Oop::nil());
-	longresult = args->basicAt(1).as<Smi>().smi();
-	if (args->basicAt(2).as<Smi>().smi() < 0)
-		longresult >>= -args->basicAt(2).as<Smi>().smi();
-	else
-		longresult <<= args->basicAt(2).as<Smi>().smi();
-	return (Smi(longresult));
+	else if (!a.isSmi())
+		return (LongIntegerOopDesc::bitShift(omem, a, b.smi()));
+
+	val = a.smi();
+	shift = b.smi();
+	if (shift < 0)
+		return (Smi(val >> std::min<int64_t>(-shift, 63)));
+	else if (shift < 64 - VT_tagBits) {
+		int64_t result = (int64_t)((uint64_t)val << shift);
+		if (result >> shift == val && VT_fitsSmi(result))
+			return (Smi(result));
+	}
+	return (LongIntegerOopDesc::bitShift(omem, a, shift));
 }
 
+/**
+ * @}
+ */
+
 /*
 Returns the field count of the von Neumann space of the receiver up to
 the left-most null.
 Called from String>>size
 */
 Oop
-primStringSize(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primStringSize(ObjectMemory &omem, ProcessOop &proc, Oop string)
 {
-	return Smi(strlen((char *)args->basicAt(1).as<StringOop>()->vns()));
+	return Smi(strlen((char *)string.as<StringOop>()->vns()));
 }
 
 int strHash(std::string str);
@@ -781,10 +824,10 @@ Called from
   Symbol>>stringHash
 */
 Oop
-primStringHash(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primStringHash(ObjectMemory &omem, ProcessOop &proc, Oop string)
 {
 	return (
-	    Smi(strHash((char *)args->basicAt(1).as<StringOop>()->vns())));
+	    Smi(strHash((char *)string.as<StringOop>()->vns())));
 }
 
 /*
@@ -795,10 +838,10 @@ object will refer to the copy.
 Called from String>>asSymbol
 */
 Oop
-primAsSymbol(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primAsSymbol(ObjectMemory &omem, ProcessOop &proc, Oop string)
 {
 	return ((Oop)SymbolOopDesc::fromString(omem,
-	    (char *)args->basicAt(1).as<StringOop>()->vns()));
+	    (char *)string.as<StringOop>()->vns()));
 }
 
 /*
@@ -807,10 +850,10 @@ function.  Returns what that function returns.
 Called from String>>unixCommand
 */
 Oop
-primHostCommand(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primHostCommand(ObjectMemory &omem, ProcessOop &proc, Oop string)
 {
 	return (
-	    Smi(system((char *)args->basicAt(1).as<StringOop>()->vns())));
+	    Smi(system((char *)string.as<StringOop>()->vns())));
 }
 
 /*
@@ -819,11 +862,11 @@ representation.
 Called from Float>>printString
 */
 Oop
-primAsString(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primAsString(ObjectMemory &omem, ProcessOop &proc, Oop flo)
 {
 	char buffer[32];
 	(void)sprintf(buffer, "%g",
-	    args->basicAt(1).as<FloatOop>()->floatValue());
+	    flo.as<FloatOop>()->floatValue());
 	return ((Oop)StringOopDesc::fromString(omem, buffer));
 }
 
@@ -832,10 +875,10 @@ Returns the natural logarithm of the receiver's value.
 Called from Float>>ln
 */
 Oop
-primNaturalLog(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primNaturalLog(ObjectMemory &omem, ProcessOop &proc, Oop flo)
 {
 	return (
-	    (Oop)FloatOop(log(args->basicAt(1).as<FloatOop>()->floatValue())));
+	    (Oop)FloatOop(log(flo.as<FloatOop>()->floatValue())));
 }
 
 /*
@@ -843,10 +886,10 @@ Returns "e" raised to a power denoted by the receiver's value.
 Called from Float>>exp
 */
 Oop
-primERaisedTo(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primERaisedTo(ObjectMemory &omem, ProcessOop &proc, Oop flo)
 {
 	return (
-	    (Oop)FloatOop(exp(args->basicAt(1).as<FloatOop>()->floatValue())));
+	    (Oop)FloatOop(exp(flo.as<FloatOop>()->floatValue())));
 }
 
 /*
@@ -855,14 +898,14 @@ receiver's value can be expressed as n * 2**m.
 Called from Float>>integerPart
 */
 Oop
-primIntegerPart(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primIntegerPart(ObjectMemory &omem, ProcessOop &proc, Oop flo)
 {
 	double temp;
 	int i;
 	int j;
 	ArrayOop returnedObject = Oop::nil().as<ArrayOop>();
 #define ndif 12
-	temp = frexp(args->basicAt(1).as<FloatOop>()->floatValue(), &i);
+	temp = frexp(flo.as<FloatOop>()->floatValue(), &i);
 	if ((i >= 0) && (i <= ndif)) {
 		temp = ldexp(temp, i);
 		i = 0;
@@ -876,10 +919,10 @@ primIntegerPart(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
 	returnedObject->basicAtPut(2, Smi(i));
 #ifdef trynew
 	/* if number is too big it can't be integer anyway */
-	if (args->basicAt(1).as<FloatOop>()->floatValue() > 2e9)
+	if (flo.as<FloatOop>()->floatValue() > 2e9)
 		returnedObject = nil;
 	else {
-		(void)modf(args->basicAt(1).as<FloatOop>()->floatValue(),
+		(void)modf(flo.as<FloatOop>()->floatValue(),
 		    &temp);
 		ltemp = (long)temp;
 		if (canEmbed(ltemp))
@@ -897,11 +940,11 @@ value.
 Called from Float>>+
 */
 Oop
-primFloatAdd(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatAdd(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
 	double result;
-	result = args->basicAt(1).as<FloatOop>()->floatValue();
-	result += args->basicAt(2).as<FloatOop>()->floatValue();
+	result = a.as<FloatOop>()->floatValue();
+	result += b.as<FloatOop>()->floatValue();
 	return ((Oop)FloatOop(result));
 }
 
@@ -911,11 +954,11 @@ receiver's value.
 Called from Float>>-
 */
 Oop
-primFloatSubtract(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatSubtract(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
 	double result;
-	result = args->basicAt(1).as<FloatOop>()->floatValue();
-	result -= args->basicAt(2).as<FloatOop>()->floatValue();
+	result = a.as<FloatOop>()->floatValue();
+	result -= b.as<FloatOop>()->floatValue();
 	return ((Oop)FloatOop(result));
 }
 
@@ -925,10 +968,10 @@ value; false otherwise.
 Called from Float>><
 */
 Oop
-primFloatLessThan(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatLessThan(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (args->basicAt(1).as<FloatOop>()->floatValue() <
-	    args->basicAt(2).as<FloatOop>()->floatValue())
+	if (a.as<FloatOop>()->floatValue() <
+	    b.as<FloatOop>()->floatValue())
 		return ((Oop)ObjectMemory::objTrue);
 	else
 		return ((Oop)ObjectMemory::objFalse);
@@ -940,10 +983,10 @@ value; false otherwise.
 Not called from the image.
 */
 Oop
-primFloatGreaterThan(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatGreaterThan(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (args->basicAt(1).as<FloatOop>()->floatValue() >
-	    args->basicAt(2).as<FloatOop>()->floatValue())
+	if (a.as<FloatOop>()->floatValue() >
+	    b.as<FloatOop>()->floatValue())
 		return ((Oop)ObjectMemory::objTrue);
 	else
 		return ((Oop)ObjectMemory::objFalse);
@@ -955,10 +998,10 @@ argument's value; false otherwise.
 Not called from the image.
 */
 Oop
-primFloatLessOrEqual(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatLessOrEqual(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (args->basicAt(1).as<FloatOop>()->floatValue() <=
-	    args->basicAt(2).as<FloatOop>()->floatValue())
+	if (a.as<FloatOop>()->floatValue() <=
+	    b.as<FloatOop>()->floatValue())
 		return ((Oop)ObjectMemory::objTrue);
 	else
 		return ((Oop)ObjectMemory::objFalse);
@@ -970,10 +1013,10 @@ argument's value; false otherwise.
 Not called from the image.
 */
 Oop
-primFloatGreaterOrEqual(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatGreaterOrEqual(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (args->basicAt(1).as<FloatOop>()->floatValue() >=
-	    args->basicAt(2).as<FloatOop>()->floatValue())
+	if (a.as<FloatOop>()->floatValue() >=
+	    b.as<FloatOop>()->floatValue())
 		return ((Oop)ObjectMemory::objTrue);
 	else
 		return ((Oop)ObjectMemory::objFalse);
@@ -985,10 +1028,10 @@ false otherwise.
 Called from Float>>=
 */
 Oop
-primFloatEqual(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatEqual(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (args->basicAt(1).as<FloatOop>()->floatValue() ==
-	    args->basicAt(2).as<FloatOop>()->floatValue())
+	if (a.as<FloatOop>()->floatValue() ==
+	    b.as<FloatOop>()->floatValue())
 		return ((Oop)ObjectMemory::objTrue);
 	else
 		return ((Oop)ObjectMemory::objFalse);
@@ -1000,10 +1043,10 @@ value; false otherwise.
 Not called from the image.
 */
 Oop
-primFloatNotEqual(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatNotEqual(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
-	if (args->basicAt(1).as<FloatOop>()->floatValue() !=
-	    args->basicAt(2).as<FloatOop>()->floatValue())
+	if (a.as<FloatOop>()->floatValue() !=
+	    b.as<FloatOop>()->floatValue())
 		return ((Oop)ObjectMemory::objTrue);
 	else
 		return ((Oop)ObjectMemory::objFalse);
@@ -1015,11 +1058,11 @@ argument's value.
 Called from Float>>*
 */
 Oop
-primFloatMultiply(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatMultiply(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
 	double result;
-	result = args->basicAt(1).as<FloatOop>()->floatValue();
-	result *= args->basicAt(2).as<FloatOop>()->floatValue();
+	result = a.as<FloatOop>()->floatValue();
+	result *= b.as<FloatOop>()->floatValue();
 	return ((Oop)FloatOop(result));
 }
 
@@ -1029,11 +1072,11 @@ value.
 Called from Float>>/
 */
 Oop
-primFloatDivide(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFloatDivide(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
 {
 	double result;
-	result = args->basicAt(1).as<FloatOop>()->floatValue();
-	result /= args->basicAt(2).as<FloatOop>()->floatValue();
+	result = a.as<FloatOop>()->floatValue();
+	result /= b.as<FloatOop>()->floatValue();
 	return ((Oop)FloatOop(result));
 }
 
@@ -1049,10 +1092,10 @@ Returns non-nil if successful; nil otherwise.
 Called from File>>open
 */
 Oop
-primFileOpen(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFileOpen(ObjectMemory &omem, ProcessOop &proc, Oop fileNum, Oop name)
 {
-	int i = args->basicAt(1).as<Smi>().smi();
-	char *p = (char *)args->basicAt(2).as<StringOop>()->vns();
+	int i = fileNum.as<Smi>().smi();
+	char *p = (char *)name.as<StringOop>()->vns();
 	if (!strcmp(p, "stdin"))
 		fp[i] = stdin;
 	else if (!strcmp(p, "stdout"))
@@ -1060,7 +1103,7 @@ primFileOpen(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
 	else if (!strcmp(p, "stderr"))
 		fp[i] = stderr;
 	else {
-		char *q = (char *)args->basicAt(2).as<StringOop>()->vns();
+		char *q = (char *)name.as<StringOop>()->vns();
 		char *r = strchr(q, 'b');
 		ByteOop s;
 		if (r == NULL) {
@@ -1087,9 +1130,9 @@ Always fails.
 Called from File>>close
 */
 Oop
-primFileClose(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFileClose(ObjectMemory &omem, ProcessOop &proc, Oop fileNum)
 {
-	int i = args->basicAt(1).as<Smi>().smi();
+	int i = fileNum.as<Smi>().smi();
 	if (fp[i])
 		(void)fclose(fp[i]);
 	fp[i] = NULL;
@@ -1107,11 +1150,11 @@ N.B.:  The built-in function uses the built-in compiler.  Both should be
 used only in connection with building an initial image.
 */
 Oop
-primFileIn(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFileIn(ObjectMemory &omem, ProcessOop &proc, Oop fileNum)
 {
-	/*int i = args->basicAt (1).as<SmiOop> ().smi ();
+	/*int i = fileNum.as<SmiOop> ().smi ();
 	if (fp[i])
-	    coldFileIn (args->basicAt (1)->val);
+	    coldFileIn (fileNum->val);
 	return (Oop::nil ());*/
 }
 
@@ -1129,9 +1172,9 @@ Returns the new String if successful, nil otherwise.
 Called from File>>getString
 */
 Oop
-primGetString(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primGetString(ObjectMemory &omem, ProcessOop &proc, Oop fileNum)
 {
-	int i = args->basicAt(1).as<Smi>().smi();
+	int i = fileNum.as<Smi>().smi();
 	int j;
 	char buffer[4096];
 	if (!fp[i])
@@ -1165,13 +1208,14 @@ Always fails.
 Called from File>>printNoReturn:
 */
 Oop
-primPrintWithoutNL(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primPrintWithoutNL(ObjectMemory &omem, ProcessOop &proc, Oop fileNum,
+    Oop string)
 {
-	int i = args->basicAt(1).as<Smi>().smi(); // smiOf
+	int i = fileNum.as<Smi>().smi(); // smiOf
 						     // (arg[0].val);
 	if (!fp[i])
 		return (Oop());
-	(void)fputs((char *)args->basicAt(2).as<ByteArrayOop>()->vns(), fp[i]);
+	(void)fputs((char *)string.as<ByteArrayOop>()->vns(), fp[i]);
 	(void)fflush(fp[i]);
 	return (Oop());
 }
@@ -1183,12 +1227,12 @@ Always fails.
 Called from File>>print:
 */
 Oop
-primPrintWithNL(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primPrintWithNL(ObjectMemory &omem, ProcessOop &proc, Oop fileNum, Oop string)
 {
-	int i = args->basicAt(1).as<Smi>().smi();
+	int i = fileNum.as<Smi>().smi();
 	if (!fp[i])
 		return (Oop());
-	(void)fputs((char *)args->basicAt(2).as<ByteArrayOop>()->vns(), fp[i]);
+	(void)fputs((char *)string.as<ByteArrayOop>()->vns(), fp[i]);
 	(void)fputc('\n', fp[i]);
 	return (Oop());
 }
@@ -1210,37 +1254,37 @@ primExecBlock(ObjectMemory &omem, ProcessOop &proc, size_t nArgs, Oop args[])
 }
 
 Oop
-primDumpVariable(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primDumpVariable(ObjectMemory &omem, ProcessOop &proc, Oop obj)
 {
 	ContextOop ctx = proc->context();
 
 	printf("Dump variable:\n");
 
-	args->basicAt(1).print(20);
-	args->basicAt(1).isa()->print(20);
+	obj.print(20);
+	obj.isa()->print(20);
 	return Oop();
 }
 
 Oop
-primMsg(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primMsg(ObjectMemory &omem, ProcessOop &proc, Oop string)
 {
 	printf("Debug message:\n\t%s\n",
-	    args->basicAt(1).as<StringOop>()->asCStr());
+	    string.as<StringOop>()->asCStr());
 	return Oop();
 }
 
 Oop
-primFatal(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primFatal(ObjectMemory &omem, ProcessOop &proc, Oop string)
 {
-	printf("Fatal error: %s\n", args->basicAt(1).as<StringOop>()->asCStr());
+	printf("Fatal error: %s\n", string.as<StringOop>()->asCStr());
 	abort();
 	return Oop();
 }
 
 Oop
-primExecuteNative(ObjectMemory &omem, ProcessOop proc, ArrayOop args)
+primExecuteNative(ObjectMemory &omem, ProcessOop &proc, Oop code)
 {
-	//    args->basicAt (1)->asNativeCodeOop ()->fun () ((void *)proc.index
+	//    code->asNativeCodeOop ()->fun () ((void *)proc.index
 	//    ());
 	return Oop();
 }
@@ -1267,6 +1311,32 @@ Primitive::named(std::string name)
 	return NULL;
 }
 
+/**
+ * Returns the result \p r of a system call as a SmallInteger; or nil if it
+ * would have blocked, or the negated errno if it failed otherwise.
+ */
+static Oop
+ioResult(ssize_t r)
+{
+	if (r >= 0)
+		return Smi((int64_t)r);
+	else if (errno == EAGAIN || errno == EWOULDBLOCK)
+		return Oop::nil();
+	else
+		return Smi((int64_t)-errno);
+}
+
+/** Checks that \p start and \p count, 1-based, lie within \p bytes. */
+static bool
+bytesRange(Oop bytes, Oop start, Oop count)
+{
+	return !bytes.isSmi() && bytes.as<MemOop>()->isBytes() &&
+	    start.isSmi() && count.isSmi() && start.smi() >= 1 &&
+	    count.smi() >= 0 &&
+	    (size_t)(start.smi() - 1 + count.smi()) <=
+		bytes.as<MemOop>()->size();
+}
+
 /**
  * \defgroup File stream manipulation
  * @{
@@ -1321,81 +1391,1153 @@ primFileStarPut(ObjectMemory &omem, ProcessOop &proc, Oop stream, Oop obj)
 	return Oop::nil();
 }
 
+/*
+Opens the file named by the first argument for reading, if the second is
+#r; for writing, truncating or creating it, if #w; or for appending,
+creating it, if #a.
+Returns the file descriptor, or the negated errno.
+Called from FileStream class>>open:mode:bufferSize:
+*/
+Oop
+primFdOpen(ObjectMemory &omem, ProcessOop &proc, Oop path, Oop mode)
+{
+	int flags;
+
+	if (path.isa() != ObjectMemory::clsString ||
+	    mode.isa() != ObjectMemory::clsSymbol)
+		return Smi((int64_t)-EINVAL);
+
+	if (mode.as<SymbolOop>()->strEquals("r"))
+		flags = O_RDONLY;
+	else if (mode.as<SymbolOop>()->strEquals("w"))
+		flags = O_WRONLY | O_CREAT | O_TRUNC;
+	else if (mode.as<SymbolOop>()->strEquals("a"))
+		flags = O_WRONLY | O_CREAT | O_APPEND;
+	else
+		return Smi((int64_t)-EINVAL);
+
+	return ioResult(open(path.as<StringOop>()->asCStr(),
+	    flags | O_CLOEXEC, 0666));
+}
+
+/*
+Reads into the byte object given by the second argument, at the index given
+by the third, at most as many bytes as the fourth from the file descriptor
+given by the first.  Unlike socketRead, this blocks the CPU thread, as
+read(2) on regular files does anyway.
+Returns the number read, 0 at end of file; or the negated errno.
+Called from ReadStream>>fill
+*/
+Oop
+primFdRead(ObjectMemory &omem, ProcessOop &proc, size_t nArgs, Oop args[])
+{
+	Oop fd, buffer, start, count;
+	ssize_t r;
+
+	if (nArgs != 4)
+		return Smi((int64_t)-EINVAL);
+	fd = args[0], buffer = args[1], start = args[2], count = args[3];
+	if (!fd.isSmi() || !bytesRange(buffer, start, count))
+		return Smi((int64_t)-EINVAL);
+	do
+		r = read(fd.smi(),
+		    buffer.as<ByteOop>()->vns() + start.smi() - 1, count.smi());
+	while (r == -1 && errno == EINTR);
+	return ioResult(r);
+}
+
+/*
+Writes to the file descriptor given by the first argument the bytes of the
+second argument from the index given by the third, as many as the fourth,
+retrying short writes until all are written.
+Returns the number written; or the negated errno.
+Called from WriteStream>>flush
+*/
+Oop
+primFdWrite(ObjectMemory &omem, ProcessOop &proc, size_t nArgs, Oop args[])
+{
+	Oop fd, bytes, start, count;
+	uint8_t *from;
+	size_t left;
+
+	if (nArgs != 4)
+		return Smi((int64_t)-EINVAL);
+	fd = args[0], bytes = args[1], start = args[2], count = args[3];
+	if (!fd.isSmi() || !bytesRange(bytes, start, count))
+		return Smi((int64_t)-EINVAL);
+
+	from = bytes.as<ByteOop>()->vns() + start.smi() - 1;
+	left = count.smi();
+	while (left > 0) {
+		ssize_t r = write(fd.smi(), from, left);
+
+		if (r == -1 && errno == EINTR)
+			continue;
+		else if (r == -1)
+			return ioResult(r);
+		from += r;
+		left -= r;
+	}
+	return count;
+}
+
+/*
+Closes the file descriptor given by the argument.
+Returns 0, or the negated errno.
+Called from FileStream>>close
+*/
+Oop
+primFdClose(ObjectMemory &omem, ProcessOop &proc, Oop fd)
+{
+	if (!fd.isSmi())
+		return Smi((int64_t)-EBADF);
+	return ioResult(close(fd.smi()));
+}
+
 /**
  * @}
  */
 
+/**
+ * \defgroup Mapped files
+ * Files mapped read-only into memory. A mapping is a NativePointer of two
+ * words, the base address and the length, so that the primitives can check
+ * their indices against the length without trusting the image; a plain
+ * NativePointer is refused. An empty file is mapped as a null base of
+ * length 0, since mmap(2) refuses those.
+ * @{
+ */
+
+/**
+ * Returns the words of the mapping \p map, or NULL if it is no mapping.
+ * The first is the base address and the second the length.
+ */
+static uintptr_t *
+mappingOf(Oop map)
+{
+	if (map.isa() != ObjectMemory::clsNativePointer ||
+	    map.as<MemOop>()->size() != 2 * sizeof(uintptr_t))
+		return NULL;
+	return (uintptr_t *)&map.as<NativePointerOop>()->vns();
+}
+
+/*
+Maps the whole of the file named by the argument, read-only.
+Returns the mapping, or the negated errno.
+Called from MappedFile class>>open:
+*/
 Oop
-primDisableInterrupts(ObjectMemory &omem, ProcessOop &proc)
+primMapFile(ObjectMemory &omem, ProcessOop &proc, Oop path)
 {
-	CPUThreadPair::curpair()->disableInterrupts();
+	struct stat sb;
+	void *base = NULL;
+	int fd, err;
+	NativePointerOop map;
 
-	return Oop::nil();
+	if (path.isa() != ObjectMemory::clsString)
+		return Smi((int64_t)-EINVAL);
+
+	fd = open(path.as<StringOop>()->asCStr(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return ioResult(-1);
+	if (fstat(fd, &sb) == -1) {
+		err = errno;
+		close(fd);
+		return Smi((int64_t)-err);
+	}
+	if (sb.st_size > 0) {
+		base = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		err = errno;
+	}
+	/* the mapping outlives the descriptor */
+	close(fd);
+	if (base == MAP_FAILED)
+		return Smi((int64_t)-err);
+
+	map = omem.newByteObj<NativePointerOop>(2 * sizeof(uintptr_t));
+	map.setIsa(ObjectMemory::clsNativePointer);
+	mappingOf(map)[0] = (uintptr_t)base;
+	mappingOf(map)[1] = sb.st_size;
+	return map;
 }
 
+/*
+Unmaps the mapping given by the argument, leaving it empty, so that it may
+be closed again harmlessly.
+Returns 0, or the negated errno.
+Called from MappedFile>>close
+*/
 Oop
-primEnableInterrupts(ObjectMemory &omem, ProcessOop &proc)
+primMapClose(ObjectMemory &omem, ProcessOop &proc, Oop map)
 {
-	CPUThreadPair::curpair()->enableInterrupts();
+	uintptr_t *words = mappingOf(map);
+	int r = 0;
 
-	return Oop::nil();
+	if (words == NULL)
+		return Smi((int64_t)-EINVAL);
+	if (words[1] > 0)
+		r = munmap((void *)words[0], words[1]);
+	words[0] = 0;
+	words[1] = 0;
+	return ioResult(r);
 }
 
+/*
+Returns the length of the mapping given by the argument, or nil if it is
+none.
+Called from MappedFile>>size
+*/
 Oop
-primNewProcessMessage(ObjectMemory &omem, ProcessOop &aProc, Oop aReceiver,
-    Oop selector, Oop anArgArray)
+primMapSize(ObjectMemory &omem, ProcessOop &proc, Oop map)
 {
-	assert(selector.isa() == ObjectMemory::clsSymbol);
-	assert(anArgArray.isNil() ||
-	    anArgArray.isa() == ObjectMemory::clsArray);
-
-	ProcessOop proc = ProcessOopDesc::allocate(omem);
-	MethodOop meth = lookupMethod(aReceiver, aReceiver.isa(),
-	    selector.as<SymbolOop>());
+	uintptr_t *words = mappingOf(map);
 
-	assert(!meth.isNil());
+	if (words == NULL)
+		return Oop::nil();
+	return Smi((int64_t)words[1]);
+}
 
-	ContextOop ctx = proc->context();
-	proc->pid = nextPid++;
-	ctx->initWithMethod(omem, aReceiver, meth);
+/*
+Returns the byte of the mapping given by the first argument at the 1-based
+index given by the second, or nil if out of bounds.
+Called from MappedFile>>byteAt:
+*/
+Oop
+primMapByteAt(ObjectMemory &omem, ProcessOop &proc, Oop map, Oop index)
+{
+	uintptr_t *words = mappingOf(map);
 
-	return proc;
+	if (words == NULL || !index.isSmi() || index.smi() < 1 ||
+	    (uintptr_t)index.smi() > words[1])
+		return Oop::nil();
+	return Smi((int64_t)((uint8_t *)words[0])[index.smi() - 1]);
 }
 
-void doWithBlock(volatile MemOopDesc * anObj)
+/*
+Returns the index of the first byte of the mapping given by the first
+argument equal to the second, searching from the index given by the third
+to the end, or 0 if there is none.
+Called from MappedFile>>indexOf:startingAt:
+*/
+Oop
+primMapIndexOf(ObjectMemory &omem, ProcessOop &proc, Oop map, Oop byte,
+    Oop start)
 {
-	anObj;
+	uintptr_t *words = mappingOf(map);
+	uint8_t *base, *found;
+
+	if (words == NULL || !byte.isSmi() || byte.smi() < 0 ||
+	    byte.smi() > 255 || !start.isSmi() || start.smi() < 1)
+		return Oop::nil();
+	if ((uintptr_t)start.smi() > words[1])
+		return Smi((int64_t)0);
+
+	base = (uint8_t *)words[0];
+	found = (uint8_t *)memchr(base + start.smi() - 1, byte.smi(),
+	    words[1] - (start.smi() - 1));
+	return Smi(found == NULL ? (int64_t)0 : int64_t(found - base + 1));
 }
 
+/*
+Returns a new String of the bytes of the mapping given by the first
+argument from the index given by the second through that given by the
+third, or nil if they are out of bounds.
+Called from MappedFile>>copyFrom:to:
+*/
 Oop
-primProcNewFork(ObjectMemory &omem, ProcessOop &proc, Oop blockToCall)
+primMapCopyFromTo(ObjectMemory &omem, ProcessOop &proc, Oop map, Oop from,
+    Oop to)
 {
-	assert(blockToCall.isa() == ObjectMemory::clsBlock);
-
-	ProcessOop newProc = omem.copyObj<ProcessOop>(proc.m_ptr);
-	newProc->pid = nextPid++;
-	newProc->stack = omem.copyObj<ArrayOop>(newProc->stack.m_ptr);
+	uintptr_t *words = mappingOf(map);
+	uint8_t *src;
+	intptr_t len;
+	StringOop ans;
 
-	primExecBlock(omem, newProc, 1, &blockToCall);
+	if (words == NULL || !from.isSmi() || !to.isSmi() || from.smi() < 1 ||
+	    to.smi() < from.smi() - 1 || (uintptr_t)to.smi() > words[1])
+		return Oop::nil();
 
-	return newProc;
+	src = (uint8_t *)words[0] + from.smi() - 1;
+	len = to.smi() - from.smi() + 1;
+	ans = omem.newByteObj<StringOop>(len + 1);
+	(void)memcpy(ans->vns(), src, len);
+	ans.setIsa(ObjectMemory::clsString);
+	return ans;
 }
 
-/*Oop
-primProcCurrentWait(ObjectMemory &omem, ProcessOop &proc)
+/**
+ * @}
+ */
+
+/**
+ * \defgroup Sockets
+ * TCP and Unix-domain stream sockets, all non-blocking. Sockets are denoted by
+ * their file descriptors. Where an operation would block, its primitive
+ * returns nil, and the caller parks with socketAwait till the libev loop
+ * finds the socket ready, then tries again; other failures return the
+ * negated errno.
+ * @{
+ */
+
+/** Makes \p fd non-blocking and close-on-exec. */
+static int
+setNonBlocking(int fd)
 {
-	proc->state = 3;
-	return proc;
-}*/
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1 ||
+	    fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+		return -1;
+	return fd;
+}
 
-Oop
-primProcResume(ObjectMemory &omem, ProcessOop &proc, Oop anObj)
+/**
+ * Fills in \p addr for the Unix-domain socket path \p path.
+ * @return false if \p path is not a String or is too long.
+ */
+static bool
+unixAddress(Oop path, struct sockaddr_un &addr)
 {
-	assert(anObj.isa() == ObjectMemory::clsProcess);
-	ProcessOop aProc = anObj.as<ProcessOop>();
-	aProc->state = 1;
-	CPUThreadPair::curpair()->scheduler()->addProcToRunnables(aProc);
-	return anObj;
+	if (path.isa() != ObjectMemory::clsString)
+		return false;
+
+	const char *str = (const char *)path.as<StringOop>()->vns();
+
+	if (strlen(str) >= sizeof(addr.sun_path))
+		return false;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, str);
+	return true;
+}
+
+/**
+ * Makes a socket of \p family bound to \p addr and listening.
+ * @return The socket, or -1 with errno set.
+ */
+static int
+listenOn(int family, const struct sockaddr *addr, socklen_t len)
+{
+	int fd = socket(family, SOCK_STREAM, 0), one = 1;
+
+	if (fd == -1)
+		return -1;
+	if ((family == AF_INET &&
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ==
+		    -1) ||
+	    bind(fd, addr, len) == -1 || listen(fd, SOMAXCONN) == -1 ||
+	    setNonBlocking(fd) == -1) {
+		int err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * Makes a socket of \p family and starts it connecting to \p addr.
+ * @return The socket, or -1 with errno set.
+ */
+static int
+connectTo(int family, const struct sockaddr *addr, socklen_t len)
+{
+	int fd = socket(family, SOCK_STREAM, 0);
+
+	if (fd == -1)
+		return -1;
+	if (setNonBlocking(fd) == -1 ||
+	    (connect(fd, addr, len) == -1 && errno != EINPROGRESS)) {
+		int err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+	return fd;
+}
+
+/*
+Returns a TCP socket listening on all interfaces on the port given by the
+argument.
+Called from Socket class>>listenOnPort:
+*/
+Oop
+primSocketListenTCP(ObjectMemory &omem, ProcessOop &proc, Oop port)
+{
+	struct sockaddr_in addr = {};
+
+	if (!port.isSmi() || port.smi() < 0 || port.smi() > 65535)
+		return Smi((int64_t)-EINVAL);
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port.smi());
+	return ioResult(listenOn(AF_INET, (struct sockaddr *)&addr,
+	    sizeof(addr)));
+}
+
+/*
+Returns a Unix-domain socket listening at the path given by the argument.
+Called from Socket class>>listenOnPath:
+*/
+Oop
+primSocketListenUnix(ObjectMemory &omem, ProcessOop &proc, Oop path)
+{
+	struct sockaddr_un addr;
+
+	if (!unixAddress(path, addr))
+		return Smi((int64_t)-EINVAL);
+	return ioResult(listenOn(AF_UNIX, (struct sockaddr *)&addr,
+	    sizeof(addr)));
+}
+
+/*
+Returns a TCP socket connecting to the host and port given by the arguments.
+The connection is complete once the socket is writable; socketError then
+tells whether it succeeded. Looking up a host name, rather than a numeric
+address, blocks.
+Called from Socket class>>connectToHost:port:
+*/
+Oop
+primSocketConnectTCP(ObjectMemory &omem, ProcessOop &proc, Oop host, Oop port)
+{
+	struct addrinfo hints = {}, *res;
+	char service[8];
+	int fd;
+
+	if (host.isa() != ObjectMemory::clsString || !port.isSmi() ||
+	    port.smi() < 0 || port.smi() > 65535)
+		return Smi((int64_t)-EINVAL);
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICSERV;
+	snprintf(service, sizeof(service), "%d", (int)port.smi());
+	if (getaddrinfo((const char *)host.as<StringOop>()->vns(), service,
+		&hints, &res) != 0)
+		return Smi((int64_t)-EHOSTUNREACH);
+
+	fd = connectTo(res->ai_family, res->ai_addr, res->ai_addrlen);
+	freeaddrinfo(res);
+	return ioResult(fd);
+}
+
+/*
+Returns a Unix-domain socket connecting to the path given by the argument.
+Called from Socket class>>connectToPath:
+*/
+Oop
+primSocketConnectUnix(ObjectMemory &omem, ProcessOop &proc, Oop path)
+{
+	struct sockaddr_un addr;
+
+	if (!unixAddress(path, addr))
+		return Smi((int64_t)-EINVAL);
+	return ioResult(connectTo(AF_UNIX, (struct sockaddr *)&addr,
+	    sizeof(addr)));
+}
+
+/*
+Returns the pending error of the socket given by the argument, as a negated
+errno, or 0 if none; so whether a connection succeeded.
+Called from Socket>>checkConnected
+*/
+Oop
+primSocketError(ObjectMemory &omem, ProcessOop &proc, Oop fd)
+{
+	int err;
+	socklen_t len = sizeof(err);
+
+	if (!fd.isSmi())
+		return Smi((int64_t)-EBADF);
+	if (getsockopt(fd.smi(), SOL_SOCKET, SO_ERROR, &err, &len) == -1)
+		return Smi((int64_t)-errno);
+	return Smi((int64_t)-err);
+}
+
+/*
+Returns the local port of the TCP socket given by the argument, so the port
+the system chose for a socket listening on port 0.
+Called from Socket>>port
+*/
+Oop
+primSocketPort(ObjectMemory &omem, ProcessOop &proc, Oop fd)
+{
+	struct sockaddr_storage addr;
+	socklen_t len = sizeof(addr);
+
+	if (!fd.isSmi())
+		return Smi((int64_t)-EBADF);
+	if (getsockname(fd.smi(), (struct sockaddr *)&addr, &len) == -1)
+		return Smi((int64_t)-errno);
+	if (addr.ss_family == AF_INET)
+		return Smi((int64_t)ntohs(
+		    ((struct sockaddr_in *)&addr)->sin_port));
+	if (addr.ss_family == AF_INET6)
+		return Smi((int64_t)ntohs(
+		    ((struct sockaddr_in6 *)&addr)->sin6_port));
+	return Smi((int64_t)-EAFNOSUPPORT);
+}
+
+/*
+Accepts a connection on the listening socket given by the argument.
+Returns the connected socket.
+Called from Socket>>accept
+*/
+Oop
+primSocketAccept(ObjectMemory &omem, ProcessOop &proc, Oop fd)
+{
+	int conn;
+
+	if (!fd.isSmi())
+		return Smi((int64_t)-EBADF);
+	if ((conn = accept(fd.smi(), NULL, NULL)) != -1 &&
+	    setNonBlocking(conn) == -1) {
+		int err = errno;
+		close(conn);
+		errno = err;
+		conn = -1;
+	}
+	return ioResult(conn);
+}
+
+/*
+Reads into the byte object given by the second argument, at the index given
+by the third, at most as many bytes as the fourth from the socket given by
+the first.
+Returns the number read, 0 at end of file.
+Called from Socket>>read:startingAt:count:
+*/
+Oop
+primSocketRead(ObjectMemory &omem, ProcessOop &proc, size_t nArgs,
+    Oop args[])
+{
+	Oop fd, buffer, start, count;
+
+	if (nArgs != 4)
+		return Smi((int64_t)-EINVAL);
+	fd = args[0], buffer = args[1], start = args[2], count = args[3];
+	if (!fd.isSmi() || !bytesRange(buffer, start, count))
+		return Smi((int64_t)-EINVAL);
+	return ioResult(read(fd.smi(),
+	    buffer.as<ByteOop>()->vns() + start.smi() - 1, count.smi()));
+}
+
+/*
+Writes to the socket given by the first argument at most as many bytes as
+the fourth argument from the byte object given by the second, starting at
+the index given by the third.
+Returns the number written.
+Called from Socket>>write:startingAt:count:
+*/
+Oop
+primSocketWrite(ObjectMemory &omem, ProcessOop &proc, size_t nArgs,
+    Oop args[])
+{
+	Oop fd, bytes, start, count;
+
+	if (nArgs != 4)
+		return Smi((int64_t)-EINVAL);
+	fd = args[0], bytes = args[1], start = args[2], count = args[3];
+	if (!fd.isSmi() || !bytesRange(bytes, start, count))
+		return Smi((int64_t)-EINVAL);
+	return ioResult(send(fd.smi(),
+	    bytes.as<ByteOop>()->vns() + start.smi() - 1, count.smi(),
+	    MSG_NOSIGNAL));
+}
+
+/*
+Closes the socket given by the argument, first making runnable any process
+parked on it.
+Returns 0, or the negated errno.
+Called from Socket>>close
+*/
+Oop
+primSocketClose(ObjectMemory &omem, ProcessOop &proc, Oop fd)
+{
+	if (!fd.isSmi())
+		return Smi((int64_t)-EBADF);
+	CPUThreadPair::curpair()->cancelIO(fd.smi());
+	return ioResult(close(fd.smi()));
+}
+
+/*
+Parks the calling process until the socket given by the first argument is
+readable, if the second argument is 1, or writable, if 2. The libev loop of
+the CPU thread then makes it runnable again.
+Other processes may wait for the same; all are made runnable together.
+Returns the socket, or nil if the arguments are invalid.
+Called from
+  Socket>>waitReadable
+  Socket>>waitWritable
+*/
+Oop
+primSocketAwait(ObjectMemory &omem, ProcessOop &proc, Oop fd, Oop events)
+{
+	if (!fd.isSmi() || fd.smi() < 0 || !events.isSmi() ||
+	    (events.smi() != ev::READ && events.smi() != ev::WRITE))
+		return Oop::nil();
+	CPUThreadPair::curpair()->awaitIO(proc, fd.smi(), events.smi());
+	return fd;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * \defgroup LongInteger support
+ * The arithmetic proper is done by the SmallInteger primitives, which accept
+ * LongIntegers too; these accept any mixture of SmallIntegers and LongIntegers
+ * and fail (returning nil) if an operand is anything else.
+ * @{
+ */
+
+/*
+Returns a LongInteger of the same value as the receiver.
+Called from Integer>>asLongInteger
+*/
+Oop
+primSmiAsLongInteger(ObjectMemory &omem, ProcessOop &proc, Oop a)
+{
+	if (!a.isSmi())
+		return Oop::nil();
+	return LongIntegerOopDesc::fromInt64(omem, a.smi());
+}
+
+/*
+Returns a new Array of the quotient, truncated towards zero, and the
+remainder of dividing the receiver by the argument.  Fails if the
+argument is zero.
+Called from LongInteger>>quoRem:
+*/
+Oop
+primLongIntQuoRem(ObjectMemory &omem, ProcessOop &proc, Oop a, Oop b)
+{
+	Oop quo, rem;
+	ArrayOop result;
+
+	quo = LongIntegerOopDesc::quoRem(omem, a, b, rem);
+	if (quo.isNil())
+		return Oop::nil();
+
+	result = ArrayOopDesc::newWithSize(omem, 2);
+	result->basicAtPut(1, quo);
+	result->basicAtPut(2, rem);
+	return result;
+}
+
+/*
+Returns a new String representing the receiver in the base denoted by
+the argument.
+Called from LongInteger>>radix:
+*/
+Oop
+primLongIntPrintString(ObjectMemory &omem, ProcessOop &proc, Oop a,
+    Oop radix)
+{
+	if (!LongIntegerOopDesc::isInteger(a) || !radix.isSmi() ||
+	    radix.smi() < 2 || radix.smi() > 36)
+		return Oop::nil();
+	return StringOopDesc::fromString(omem,
+	    LongIntegerOopDesc::printString(a, radix.smi()));
+}
+
+/**
+ * @}
+ */
+
+/**
+ * \defgroup Hash table support
+ * Dictionary and its kin keep their entries in the same layout as the VM's
+ * own dictionaries (see DictionaryOopDesc), so these may work on them
+ * directly. Keys are compared by identity, or by equality; where the VM
+ * cannot decide equality, these fail (returning nil) and Smalltalk carries
+ * out the operation itself.
+ * @{
+ */
+
+/* Returns \p dict as a DictionaryOop, or nil if it isn't laid out as one. */
+static DictionaryOop
+hashTableFor(Oop dict, Oop hash)
+{
+	if (dict.isSmi() || dict.isNil() || !hash.isSmi() ||
+	    !dict.as<MemOop>()->isOops() ||
+	    dict.as<MemOop>()->size() < DictionaryOopDesc::clsNstLength ||
+	    dict.as<DictionaryOop>()->table().isa() != ObjectMemory::clsArray)
+		return DictionaryOop::nil();
+	return dict.as<DictionaryOop>();
+}
+
+/*
+Returns the index in the hashTable of the first argument of the entry for
+the key given by the second argument under the hash given by the third, or
+0 if there is none.  The fourth argument is true if keys are compared by
+identity.
+Called from Dictionary>>keyIndex:
+*/
+Oop
+primHashTableFind(ObjectMemory &omem, ProcessOop &proc, size_t nArgs,
+    Oop args[])
+{
+	DictionaryOop dict;
+	Oop *entry;
+
+	if (nArgs != 4 || (dict = hashTableFor(args[0], args[2])).isNil())
+		return Oop::nil();
+	entry = dict->entryFor(args[2].smi(), args[1],
+	    args[3] == ObjectMemory::objTrue);
+	if (entry == NULL)
+		return Oop::nil();
+	else if (entry[0].isNil())
+		return Smi((int64_t)0);
+	return Smi(int64_t(entry - (Oop *)dict->table()->vns() + 1));
+}
+
+/*
+Puts the value given by the fourth argument under the key given by the
+second, whose hash is given by the third, into the first argument, which is
+returned.  The fifth argument is true if keys are compared by identity.
+Called from Dictionary>>at:put:
+*/
+Oop
+primHashTableAtPut(ObjectMemory &omem, ProcessOop &proc, size_t nArgs,
+    Oop args[])
+{
+	DictionaryOop dict;
+	Oop *entry;
+
+	if (nArgs != 5 || (dict = hashTableFor(args[0], args[2])).isNil())
+		return Oop::nil();
+	entry = dict->entryFor(args[2].smi(), args[1],
+	    args[4] == ObjectMemory::objTrue);
+	if (entry == NULL)
+		return Oop::nil();
+	else if (entry[0].isNil())
+		dict->fillEntry(omem, entry, args[2].smi(), args[1], args[3]);
+	else
+		entry[1] = args[3];
+	return dict;
+}
+
+/*
+Removes the entry for the key given by the second argument under the hash
+given by the third from the first argument.  Returns true if there was
+such an entry, else false.  The fourth argument is true if keys are compared
+by identity.
+Called from Dictionary>>removeKey:ifAbsent:
+*/
+Oop
+primHashTableRemoveKey(ObjectMemory &omem, ProcessOop &proc, size_t nArgs,
+    Oop args[])
+{
+	DictionaryOop dict;
+	Oop *entry;
+
+	if (nArgs != 4 || (dict = hashTableFor(args[0], args[2])).isNil())
+		return Oop::nil();
+	entry = dict->entryFor(args[2].smi(), args[1],
+	    args[3] == ObjectMemory::objTrue);
+	if (entry == NULL)
+		return Oop::nil();
+	else if (entry[0].isNil())
+		return ObjectMemory::objFalse;
+	dict->removeEntry(entry);
+	return ObjectMemory::objTrue;
+}
+
+/*
+Returns the index in the hashTable of the receiver of the first key after
+the index given by the argument, or 0 if there are no more.
+Called from Dictionary>>binaryDo:
+*/
+Oop
+primHashTableNext(ObjectMemory &omem, ProcessOop &proc, Oop aDict,
+    Oop index)
+{
+	DictionaryOop dict = hashTableFor(aDict, index);
+	ArrayOop table;
+
+	if (dict.isNil() || index.smi() < 0)
+		return Oop::nil();
+
+	table = dict->table();
+	/* key slots are at 1, 4, 7, ... */
+	for (size_t i = (index.smi() + 2) / DictionaryOopDesc::kEntrySize *
+		 DictionaryOopDesc::kEntrySize;
+	     i < table->size(); i += DictionaryOopDesc::kEntrySize)
+		if (!table->basicAt0(i).isNil())
+			return Smi(int64_t(i + 1));
+	return Smi((int64_t)0);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * \defgroup Bulk operations on indexed objects
+ * These work on the von Neumann space of Arrays (whose elements are Oops) and
+ * of ByteArrays and Strings (whose elements are bytes) in one go. Indices
+ * are 1-based and inclusive, as in Smalltalk. They fail (returning nil) on
+ * a bad index or a mismatched kind of object, which leaves Smalltalk to
+ * carry out or reject the operation element by element.
+ * @{
+ */
+
+/* Returns the width of an element of \p obj, or 0 if it has none of use. */
+static size_t
+elementWidth(Oop obj)
+{
+	if (obj.isSmi() || obj.isNil())
+		return 0;
+	else if (obj.as<MemOop>()->isBytes())
+		return 1;
+	else if (obj.as<MemOop>()->isOops())
+		return sizeof(Oop);
+	else
+		return 0;
+}
+
+/* Returns a pointer to the element of \p obj at 1-based \p index. */
+static uint8_t *
+elementAt(Oop obj, size_t width, intptr_t index)
+{
+	return obj.as<ByteOop>()->vns() + (index - 1) * width;
+}
+
+/*
+Replaces the elements of the receiver from the index denoted by the first
+argument through that denoted by the second with those of the third
+argument, starting at the index denoted by the fourth.  The two may be
+the same object, and the ranges may overlap.  Returns the receiver.
+Called from Array>>replaceFrom:to:with:startingAt:
+*/
+Oop
+primReplaceFromToWithStartingAt(ObjectMemory &omem, ProcessOop &proc,
+    size_t nArgs, Oop args[])
+{
+	size_t width;
+	intptr_t start, stop, repStart;
+
+	if (nArgs != 5 || !args[1].isSmi() || !args[2].isSmi() ||
+	    !args[4].isSmi())
+		return Oop::nil();
+
+	width = elementWidth(args[0]);
+	start = args[1].smi();
+	stop = args[2].smi();
+	repStart = args[4].smi();
+	if (width == 0 || elementWidth(args[3]) != width || start < 1 ||
+	    stop < start - 1 || stop > args[0].as<MemOop>()->size() ||
+	    repStart < 1 ||
+	    repStart + (stop - start) > args[3].as<MemOop>()->size())
+		return Oop::nil();
+
+	memmove(elementAt(args[0], width, start),
+	    elementAt(args[3], width, repStart), (stop - start + 1) * width);
+	return args[0];
+}
+
+/*
+Puts the fourth argument at each index of the receiver from that denoted
+by the first argument through that denoted by the second.  Into bytes,
+only SmallIntegers of 0 to 255 can be put.  Returns the receiver.
+Called from Array>>from:to:put:
+*/
+Oop
+primFromToPut(ObjectMemory &omem, ProcessOop &proc, size_t nArgs, Oop args[])
+{
+	size_t width;
+	intptr_t start, stop;
+
+	if (nArgs != 4 || !args[1].isSmi() || !args[2].isSmi())
+		return Oop::nil();
+
+	width = elementWidth(args[0]);
+	start = args[1].smi();
+	stop = args[2].smi();
+	if (width == 0 || start < 1 || stop < start - 1 ||
+	    stop > args[0].as<MemOop>()->size())
+		return Oop::nil();
+
+	if (width == sizeof(Oop)) {
+		Oop *elements = (Oop *)elementAt(args[0], width, 1);
+		std::fill(elements + start - 1, elements + stop, args[3]);
+	} else if (args[3].isSmi() && args[3].smi() >= 0 &&
+	    args[3].smi() <= 255)
+		memset(elementAt(args[0], width, start), args[3].smi(),
+		    stop - start + 1);
+	else
+		return Oop::nil();
+	return args[0];
+}
+
+/*
+Returns the index of the first element of the receiver identical to the
+argument, or 0 if there is none.
+Called from Array>>identityIndexOf:
+*/
+Oop
+primIdentityIndexOf(ObjectMemory &omem, ProcessOop &proc, Oop obj,
+    Oop value)
+{
+	size_t width = elementWidth(obj);
+	size_t size;
+
+	if (width == 0)
+		return Oop::nil();
+
+	size = obj.as<MemOop>()->size();
+	if (width == sizeof(Oop)) {
+		Oop *elements = (Oop *)elementAt(obj, width, 1);
+		Oop *found = std::find(elements, elements + size, value);
+
+		return Smi(found == elements + size ?
+			(int64_t)0 : int64_t(found - elements + 1));
+	} else if (value.isSmi() && value.smi() >= 0 && value.smi() <= 255) {
+		uint8_t *bytes = elementAt(obj, width, 1);
+		uint8_t *found = (uint8_t *)memchr(bytes, value.smi(), size);
+
+		return Smi(found == NULL ?
+			(int64_t)0 : int64_t(found - bytes + 1));
+	} else
+		return Smi((int64_t)0);
+}
+
+/*
+Returns the index of the first byte of the receiver equal to the first
+argument, searching from the index denoted by the second argument through
+that denoted by the third, or 0 if there is none.
+Called from ByteArray>>indexOfByte:from:to:
+*/
+Oop
+primBytesIndexOf(ObjectMemory &omem, ProcessOop &proc, size_t nArgs,
+    Oop args[])
+{
+	intptr_t start, stop;
+	uint8_t *bytes, *found;
+
+	if (nArgs != 4 || elementWidth(args[0]) != 1 || !args[1].isSmi() ||
+	    !args[2].isSmi() || !args[3].isSmi())
+		return Oop::nil();
+
+	start = args[2].smi();
+	stop = args[3].smi();
+	if (args[1].smi() < 0 || args[1].smi() > 255 || start < 1 ||
+	    stop > args[0].as<MemOop>()->size())
+		return Oop::nil();
+	if (stop < start)
+		return Smi((int64_t)0);
+
+	bytes = elementAt(args[0], 1, 1);
+	found = (uint8_t *)memchr(bytes + start - 1, args[1].smi(),
+	    stop - start + 1);
+	return Smi(found == NULL ? (int64_t)0 : int64_t(found - bytes + 1));
+}
+
+/*
+Compares the bytes of the receiver, up to the index denoted by the first
+argument, with those of the second argument, up to the index denoted by
+the third, as unsigned numbers.  Returns -1, 0 or 1 as the receiver sorts
+before, with, or after the second argument.
+Called from ByteArray>>compare:
+*/
+Oop
+primBytesCompare(ObjectMemory &omem, ProcessOop &proc, size_t nArgs,
+    Oop args[])
+{
+	intptr_t size1, size2;
+	int cmp;
+
+	if (nArgs != 4 || elementWidth(args[0]) != 1 ||
+	    elementWidth(args[2]) != 1 || !args[1].isSmi() ||
+	    !args[3].isSmi())
+		return Oop::nil();
+
+	size1 = args[1].smi();
+	size2 = args[3].smi();
+	if (size1 < 0 || size1 > args[0].as<MemOop>()->size() || size2 < 0 ||
+	    size2 > args[2].as<MemOop>()->size())
+		return Oop::nil();
+
+	cmp = memcmp(elementAt(args[0], 1, 1), elementAt(args[2], 1, 1),
+	    size1 < size2 ? size1 : size2);
+	if (cmp == 0)
+		cmp = size1 < size2 ? -1 : size1 > size2;
+	return Smi(int64_t(cmp < 0 ? -1 : cmp > 0));
+}
+
+/**
+ * @}
+ */
+
+Oop
+primDisableInterrupts(ObjectMemory &omem, ProcessOop &proc)
+{
+	CPUThreadPair::curpair()->disableInterrupts();
+
+	return Oop::nil();
+}
+
+Oop
+primEnableInterrupts(ObjectMemory &omem, ProcessOop &proc)
+{
+	CPUThreadPair::curpair()->enableInterrupts();
+
+	return Oop::nil();
+}
+
+Oop
+primNewProcessMessage(ObjectMemory &omem, ProcessOop &aProc, Oop aReceiver,
+    Oop selector, Oop anArgArray)
+{
+	assert(selector.isa() == ObjectMemory::clsSymbol);
+	assert(anArgArray.isNil() ||
+	    anArgArray.isa() == ObjectMemory::clsArray);
+
+	ProcessOop proc = ProcessOopDesc::allocate(omem);
+	MethodOop meth = lookupMethod(aReceiver, aReceiver.isa(),
+	    selector.as<SymbolOop>());
+
+	assert(!meth.isNil());
+
+	ContextOop ctx = proc->context();
+	proc->pid = nextPid++;
+	ctx->initWithMethod(omem, aReceiver, meth);
+
+	return proc;
+}
+
+void doWithBlock(volatile MemOopDesc * anObj)
+{
+	anObj;
+}
+
+Oop
+primProcNewFork(ObjectMemory &omem, ProcessOop &proc, Oop blockToCall)
+{
+	assert(blockToCall.isa() == ObjectMemory::clsBlock);
+
+	ProcessOop newProc = omem.copyObj<ProcessOop>(proc.m_ptr);
+	newProc->pid = nextPid++;
+	newProc->stack = omem.copyObj<ArrayOop>(newProc->stack.m_ptr);
+
+	primExecBlock(omem, newProc, 1, &blockToCall);
+	/* the block is the bottom of the new process; returning ends it */
+	newProc->context()->prevBP = Smi::nil();
+
+	return newProc;
+}
+
+/*Oop
+primProcCurrentWait(ObjectMemory &omem, ProcessOop &proc)
+{
+	proc->state = 3;
+	return proc;
+}*/
+
+Oop
+primProcResume(ObjectMemory &omem, ProcessOop &proc, Oop anObj)
+{
+	assert(anObj.isa() == ObjectMemory::clsProcess);
+	ProcessOop aProc = anObj.as<ProcessOop>();
+	aProc->state = 1;
+	CPUThreadPair::curpair()->resume(aProc);
+	return anObj;
+}
+
+/*
+Removes the receiver from the run queue, if it is in it.
+Returns the receiver.
+Called from Scheduler>>removeProcess:
+*/
+Oop
+primProcSuspend(ObjectMemory &omem, ProcessOop &proc, Oop anObj)
+{
+	assert(anObj.isa() == ObjectMemory::clsProcess);
+	CPUThreadPair::curpair()->suspend(anObj.as<ProcessOop>());
+	return anObj;
+}
+
+/*
+Sets the priority of the receiver, requeueing it if it is runnable and
+preempting the current process if the receiver now outranks it.
+Returns the receiver, or nil if the priority is not a SmallInteger in range.
+Called from Process>>priority:
+*/
+Oop
+primProcSetPriority(ObjectMemory &omem, ProcessOop &proc, Oop anObj,
+    Oop priority)
+{
+	assert(anObj.isa() == ObjectMemory::clsProcess);
+
+	if (!priority.isSmi() || priority.smi() < 0 ||
+	    priority.smi() >= SchedulerOopDesc::kPriorities)
+		return Oop::nil();
+
+	CPUThreadPair::curpair()->setPriority(anObj.as<ProcessOop>(),
+	    priority.smi());
+	return anObj;
+}
+
+/*
+Parks the calling process for the number of milliseconds given by the
+argument; a libev timer on the CPU thread's loop makes it runnable again.
+Returns the argument, or nil if it is not a positive SmallInteger.
+Called from Delay>>wait
+*/
+Oop
+primDelayWait(ObjectMemory &omem, ProcessOop &proc, Oop ms)
+{
+	if (!ms.isSmi() || ms.smi() <= 0)
+		return Oop::nil();
+	CPUThreadPair::curpair()->sleep(proc, ms.smi() / 1000.);
+	return ms;
+}
+
+/*
+Arms a libev timer on the CPU thread's loop to expire the first argument, a
+Timer, after the number of milliseconds given by the second.  No process
+waits on it; the timer service collects it once expired.
+Returns the Timer's slot, or nil if the delay is not a non-negative
+SmallInteger.
+Called from Timer>>startAfter:
+*/
+Oop
+primTimerStart(ObjectMemory &omem, ProcessOop &proc, Oop timer, Oop ms)
+{
+	if (!ms.isSmi() || ms.smi() < 0)
+		return Oop::nil();
+	return Smi((int64_t)CPUThreadPair::curpair()->startTimer(timer,
+	    ms.smi() / 1000.));
+}
+
+/*
+Disarms the first argument, a Timer, which was given the slot denoted by the
+second.
+Returns true, or false if the Timer has already been collected by the timer
+service.
+Called from Timer>>cancel
+*/
+Oop
+primTimerCancel(ObjectMemory &omem, ProcessOop &proc, Oop timer, Oop slot)
+{
+	bool cancelled = slot.isSmi() && slot.smi() >= 0 &&
+	    CPUThreadPair::curpair()->cancelTimer(timer, slot.smi());
+
+	return ((Oop)(cancelled ? ObjectMemory::objTrue :
+	    ObjectMemory::objFalse));
+}
+
+/*
+Collects the Timer which expired the earliest, or, if none has expired, parks
+the calling process until one does.
+Returns the Timer, or nil if the process was parked.
+Called from Timer class>>serviceExpired
+*/
+Oop
+primTimerNextExpired(ObjectMemory &omem, ProcessOop &proc)
+{
+	return CPUThreadPair::curpair()->nextExpiredTimer(proc);
 }
 
 Oop
@@ -1409,76 +2551,122 @@ primYield(ObjectMemory &omem, ProcessOop &proc) {
 
 Primitive Primitive::primitives[] = {
 	/* smi operations */
-	{ false, kDiadic, "smiAdd", .fn2 = primAdd },
-	{ false, kDiadic, "smiSub", .fn2 = primSubtract },
-	{ false, kDiadic, "smi<", .fn2 = primLessThan },
-	{ false, kDiadic, "smi>", .fn2 = primGreaterThan },
-	{ false, kDiadic, "smi<=", .fn2 = primLessOrEqual },
-	{ false, kDiadic, "smi>=", .fn2 = primGreaterOrEqual },
-	{ false, kDiadic, "smiEq", .fn2 = primEqual },
-	{ false, kDiadic, "smiNeq", .fn2 = primNotEqual },
-	{ false, kDiadic, "smiMul", .fn2 = primMultiply },
-	{ false, kDiadic, "smiQuo", .fn2 = primQuotient },
-	{ false, kDiadic, "smiRem", .fn2 = primRemainder },
-	{ false, kDiadic, "smiBitAnd", .fn2 = primBitAnd },
-	{ false, kDiadic, "smiBitXor", .fn2 = primBitXor },
-
-	{ true, kDiadic, "smiBitShift", .fnp = primBitShift },
-
-	{ true, kMonadic, "class", .fnp = primClass },
-	{ false, kMonadic, "size", .fn1 = primSize },
-	{ true, kMonadic, "hash", .fnp = primHash },
-	{ true, kDiadic, "oopEq", .fnp = primIdent },
-	{ false, kDiadic, "classOfPut", .fn2 = primClassOfPut },
-	{ false, kDiadic, "basicAt", .fn2 = primBasicAt },
-	{ false, kDiadic, "byteAt", .fn2 = primByteAt },
-	{ false, kTriadic, "basicAtPut", .fn3 = primbasicAtPut },
-	{ false, kTriadic, "byteAtPut", .fn3 = primByteAtPut },
-
-	{ true, kMonadic, "stringAsSymbol", .fnp = primAsSymbol },
-	{ true, kMonadic, "stringSize", .fnp = primStringSize },
-	{ true, kMonadic, "stringHash", .fnp = primStringHash },
-	{ true, kDiadic, "stringCat", .fnp = primStringCat },
-	{ true, kDiadic, "copyFromTo", .fnp = primCopyFromTo },
-
-	{ true, kDiadic, "symbolAssign", .fnp = primSymbolAssign },
-
-	{ true, kMonadic, "asFloat", .fnp = primAsFloat },
-
-	{ true, kDiadic, "floatAdd", .fnp = primFloatAdd },
-	{ true, kDiadic, "floatSubtract", .fnp = primFloatSubtract },
-	{ true, kDiadic, "floatLessThan", .fnp = primFloatLessThan },
-	{ true, kDiadic, "floatGreaterThan", .fnp = primFloatGreaterThan },
-	{ true, kDiadic, "floatLessOrEqual", .fnp = primFloatLessOrEqual },
-	{ true, kDiadic, "floatGreaterOrEqual", .fnp = primFloatGreaterOrEqual },
-	{ true, kDiadic, "floatEqual", .fnp = primFloatEqual },
-	{ true, kDiadic, "floatNotEqual", .fnp = primFloatNotEqual },
-	{ true, kDiadic, "floatMultiply", .fnp = primFloatMultiply },
-	{ true, kDiadic, "floatDivide", .fnp = primFloatDivide },
-	{ true, kMonadic, "floatNaturalLog", .fnp = primNaturalLog },
-	{ true, kMonadic, "floatAsString", .fnp = primAsString },
-	{ true, kMonadic, "floatERaisedTo", .fnp = primERaisedTo },
-	{ true, kMonadic, "floatIntegerPart", .fnp = primIntegerPart },
-
-	{ false, kMonadic, "newOops", .fn1 = primAllocOrefObj },
-	{ false, kMonadic, "newBytes", .fn1 = primAllocByteObj },
-
-	{ true, kDiadic, "returnInto", .fnp = primReturnInto },
-	{ false, kVariadic, "execBlock", .fnv = primExecBlock },
-	{ true, kMonadic, "dumpVariable", .fnp = primDumpVariable },
-	{ true, kMonadic, "debugMsg", .fnp = primMsg },
-	{ true, kMonadic, "fatal", .fnp = primFatal },
-
-	{ false, kDiadic, "fileDescToFileStar", .fn2 = primFileDescToFileStar },
-	{ false, kDiadic, "fileStarPut", .fn2 = primFileStarPut },
-
-	{ false, kNiladic, "disableInterrupts", .fn0 = primDisableInterrupts },
-	{ false, kNiladic, "enableInterrupts", .fn0 = primEnableInterrupts },
-	{ false, kTriadic, "newProcessMessage", .fn3 = primNewProcessMessage },
-	{ false, kMonadic, "procNewFork", .fn1 = primProcNewFork },
-	{ false, kMonadic, "procResume", .fn1 = primProcResume },
-	{ false, kNiladic, "yield", .fn0 = primYield },
-
-
-	{ true, kMonadic, NULL, .fnp = NULL },
+	{ kDiadic, "smiAdd", .fn2 = primAdd },
+	{ kDiadic, "smiSub", .fn2 = primSubtract },
+	{ kDiadic, "smi<", .fn2 = primLessThan },
+	{ kDiadic, "smi>", .fn2 = primGreaterThan },
+	{ kDiadic, "smi<=", .fn2 = primLessOrEqual },
+	{ kDiadic, "smi>=", .fn2 = primGreaterOrEqual },
+	{ kDiadic, "smiEq", .fn2 = primEqual },
+	{ kDiadic, "smiNeq", .fn2 = primNotEqual },
+	{ kDiadic, "smiMul", .fn2 = primMultiply },
+	{ kDiadic, "smiQuo", .fn2 = primQuotient },
+	{ kDiadic, "smiRem", .fn2 = primRemainder },
+	{ kDiadic, "smiBitAnd", .fn2 = primBitAnd },
+	{ kDiadic, "smiBitXor", .fn2 = primBitXor },
+
+	{ kDiadic, "smiBitShift", .fn2 = primBitShift },
+
+	{ kMonadic, "class", .fn1 = primClass },
+	{ kMonadic, "size", .fn1 = primSize },
+	{ kMonadic, "hash", .fn1 = primHash },
+	{ kDiadic, "oopEq", .fn2 = primIdent },
+	{ kDiadic, "classOfPut", .fn2 = primClassOfPut },
+	{ kDiadic, "basicAt", .fn2 = primBasicAt },
+	{ kDiadic, "byteAt", .fn2 = primByteAt },
+	{ kTriadic, "basicAtPut", .fn3 = primbasicAtPut },
+	{ kTriadic, "byteAtPut", .fn3 = primByteAtPut },
+
+	{ kMonadic, "stringAsSymbol", .fn1 = primAsSymbol },
+	{ kMonadic, "stringSize", .fn1 = primStringSize },
+	{ kMonadic, "stringHash", .fn1 = primStringHash },
+	{ kDiadic, "stringCat", .fn2 = primStringCat },
+	{ kTriadic, "copyFromTo", .fn3 = primCopyFromTo },
+
+	{ kDiadic, "symbolAssign", .fn2 = primSymbolAssign },
+
+	{ kMonadic, "asFloat", .fn1 = primAsFloat },
+
+	{ kDiadic, "floatAdd", .fn2 = primFloatAdd },
+	{ kDiadic, "floatSubtract", .fn2 = primFloatSubtract },
+	{ kDiadic, "floatLessThan", .fn2 = primFloatLessThan },
+	{ kDiadic, "floatGreaterThan", .fn2 = primFloatGreaterThan },
+	{ kDiadic, "floatLessOrEqual", .fn2 = primFloatLessOrEqual },
+	{ kDiadic, "floatGreaterOrEqual", .fn2 = primFloatGreaterOrEqual },
+	{ kDiadic, "floatEqual", .fn2 = primFloatEqual },
+	{ kDiadic, "floatNotEqual", .fn2 = primFloatNotEqual },
+	{ kDiadic, "floatMultiply", .fn2 = primFloatMultiply },
+	{ kDiadic, "floatDivide", .fn2 = primFloatDivide },
+	{ kMonadic, "floatNaturalLog", .fn1 = primNaturalLog },
+	{ kMonadic, "floatAsString", .fn1 = primAsString },
+	{ kMonadic, "floatERaisedTo", .fn1 = primERaisedTo },
+	{ kMonadic, "floatIntegerPart", .fn1 = primIntegerPart },
+
+	{ kMonadic, "newOops", .fn1 = primAllocOrefObj },
+	{ kMonadic, "newBytes", .fn1 = primAllocByteObj },
+
+	{ kDiadic, "returnInto", .fn2 = primReturnInto },
+	{ kVariadic, "execBlock", .fnv = primExecBlock },
+	{ kMonadic, "dumpVariable", .fn1 = primDumpVariable },
+	{ kMonadic, "debugMsg", .fn1 = primMsg },
+	{ kMonadic, "fatal", .fn1 = primFatal },
+
+	{ kDiadic, "fileDescToFileStar", .fn2 = primFileDescToFileStar },
+	{ kDiadic, "fileStarPut", .fn2 = primFileStarPut },
+	{ kDiadic, "fdOpen", .fn2 = primFdOpen },
+	{ kVariadic, "fdRead", .fnv = primFdRead },
+	{ kVariadic, "fdWrite", .fnv = primFdWrite },
+	{ kMonadic, "fdClose", .fn1 = primFdClose },
+
+	{ kMonadic, "mapFile", .fn1 = primMapFile },
+	{ kMonadic, "mapClose", .fn1 = primMapClose },
+	{ kMonadic, "mapSize", .fn1 = primMapSize },
+	{ kDiadic, "mapByteAt", .fn2 = primMapByteAt },
+	{ kTriadic, "mapIndexOf", .fn3 = primMapIndexOf },
+	{ kTriadic, "mapCopyFromTo", .fn3 = primMapCopyFromTo },
+
+	{ kMonadic, "socketListenTCP", .fn1 = primSocketListenTCP },
+	{ kMonadic, "socketListenUnix", .fn1 = primSocketListenUnix },
+	{ kDiadic, "socketConnectTCP", .fn2 = primSocketConnectTCP },
+	{ kMonadic, "socketConnectUnix", .fn1 = primSocketConnectUnix },
+	{ kMonadic, "socketError", .fn1 = primSocketError },
+	{ kMonadic, "socketPort", .fn1 = primSocketPort },
+	{ kMonadic, "socketAccept", .fn1 = primSocketAccept },
+	{ kVariadic, "socketRead", .fnv = primSocketRead },
+	{ kVariadic, "socketWrite", .fnv = primSocketWrite },
+	{ kMonadic, "socketClose", .fn1 = primSocketClose },
+	{ kDiadic, "socketAwait", .fn2 = primSocketAwait },
+
+	{ kMonadic, "smiAsLongInteger", .fn1 = primSmiAsLongInteger },
+	{ kDiadic, "longIntQuoRem", .fn2 = primLongIntQuoRem },
+	{ kDiadic, "longIntPrintString", .fn2 = primLongIntPrintString },
+
+	{ kVariadic, "hashTableFind", .fnv = primHashTableFind },
+	{ kVariadic, "hashTableAtPut", .fnv = primHashTableAtPut },
+	{ kVariadic, "hashTableRemoveKey", .fnv = primHashTableRemoveKey },
+	{ kDiadic, "hashTableNext", .fn2 = primHashTableNext },
+
+	{ kVariadic, "replaceFromToWithStartingAt",
+	    .fnv = primReplaceFromToWithStartingAt },
+	{ kVariadic, "fromToPut", .fnv = primFromToPut },
+	{ kDiadic, "identityIndexOf", .fn2 = primIdentityIndexOf },
+	{ kVariadic, "bytesIndexOf", .fnv = primBytesIndexOf },
+	{ kVariadic, "bytesCompare", .fnv = primBytesCompare },
+
+	{ kNiladic, "disableInterrupts", .fn0 = primDisableInterrupts },
+	{ kNiladic, "enableInterrupts", .fn0 = primEnableInterrupts },
+	{ kTriadic, "newProcessMessage", .fn3 = primNewProcessMessage },
+	{ kMonadic, "procNewFork", .fn1 = primProcNewFork },
+	{ kMonadic, "procResume", .fn1 = primProcResume },
+	{ kMonadic, "procSuspend", .fn1 = primProcSuspend },
+	{ kDiadic, "procSetPriority", .fn2 = primProcSetPriority },
+	{ kNiladic, "yield", .fn0 = primYield },
+	{ kMonadic, "setTimeSlice", .fn1 = primSetTimeSlice },
+	{ kMonadic, "delayWait", .fn1 = primDelayWait },
+	{ kDiadic, "timerStart", .fn2 = primTimerStart },
+	{ kDiadic, "timerCancel", .fn2 = primTimerCancel },
+	{ kNiladic, "timerNextExpired", .fn0 = primTimerNextExpired },
+
+
+	{ kMonadic, NULL, .fn1 = NULL },
 };
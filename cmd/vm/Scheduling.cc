@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <ev++.h>
 #include <pthread.h>
@@ -10,61 +11,73 @@
 int64_t nextPid = 0;
 static thread_local CPUThreadPair *g_curpair = NULL;
 
-template <typename T>
-void
-addToListLast(T &list, T obj)
-{
-	if (list.isNil())
-		list = obj;
-	else {
-		T last = list;
-		while (!last->link.isNil())
-			last = last->link;
-		last->link = obj;
-	}
-}
+int CPUThreadPair::s_timeSliceMs = 100;
 
-template <typename T>
-void
-removeFromList(T &list, T obj)
+SchedulerOop
+SchedulerOopDesc::allocate(ObjectMemory &omem)
 {
-	if (list == obj) {
-		list = list->link;
-	} else {
-		T node = list;
-		while (node->link != obj) {
-			assert(!node->link.isNil());
-			node = node->link;
-		}
-
-		node->link = node->link->link;
-	}
-
-	obj->link = T::nil();
+	SchedulerOop sched = omem.newOopObj<SchedulerOop>(clstNstLength);
+
+	sched->runQueues = ArrayOopDesc::newWithSize(omem, kPriorities * 2);
+	sched->readyLevels = Smi((int64_t)0);
+	sched->ioWaits = ArrayOopDesc::newWithSize(omem, 64);
+	sched->sleepers = ArrayOopDesc::newWithSize(omem, 16);
+	sched->timers = ArrayOopDesc::newWithSize(omem, 16);
+	return sched;
 }
 
-template <typename T>
 bool
-containedInList(T &list, T obj)
+SchedulerOopDesc::outranksCurrent(ProcessOop proc)
 {
-	T link = list;
-	while (!link.isNil()) {
-		if (link == obj)
-			return true;
-		link = link->link;
-	}
-	return false;
+	return !curProc.isNil() && proc != curProc &&
+	    proc->priority.smi() > curProc->priority.smi();
 }
 
 void
+SchedulerOopDesc::unlink(ProcessOop proc)
+{
+	int priority = proc->priority.smi();
+
+	assert(proc->runQueue == SchedulerOop(this));
+
+	if (proc->prevLink.isNil())
+		head(priority) = proc->link;
+	else
+		proc->prevLink->link = proc->link;
+	if (proc->link.isNil())
+		tail(priority) = proc->prevLink;
+	else
+		proc->link->prevLink = proc->prevLink;
+	if (head(priority).isNil())
+		readyLevels = Smi(readyLevels.smi() & ~(int64_t(1) << priority));
+
+	proc->link = ProcessOop::nil();
+	proc->prevLink = ProcessOop::nil();
+	proc->runQueue = SchedulerOop::nil();
+}
+
+bool
 SchedulerOopDesc::addProcToRunnables(ProcessOop proc)
 {
+	int priority = proc->priority.smi();
+
 #ifdef TRACE_PROCS
-	std::cout << "Placing " << proc->pid.smi() << " into runqueue.\n";
+	std::cout << "Placing " << proc->pid.smi() << " into runqueue " <<
+	    priority << ".\n";
 #endif
-	assert(proc->link.isNil());
-	assert(!containedInList(runnable, proc));
-	addToListLast(runnable, proc);
+	assert(proc->runQueue.isNil() && proc->link.isNil());
+	assert(priority >= 0 && priority < kPriorities);
+
+	proc->prevLink = tail(priority);
+	if (tail(priority).isNil())
+		head(priority) = proc;
+	else
+		tail(priority)->link = proc;
+	tail(priority) = proc;
+	proc->runQueue = SchedulerOop(this);
+	readyLevels = Smi(readyLevels.smi() | int64_t(1) << priority);
+
+	return outranksCurrent(proc);
 }
 
 void
@@ -76,15 +89,34 @@ SchedulerOopDesc::suspendCurrentProcess()
 void
 SchedulerOopDesc::suspendProcess(ProcessOop proc)
 {
-	removeFromList(runnable, proc);
+	unlink(proc);
+}
+
+bool
+SchedulerOopDesc::setPriority(ProcessOop proc, int priority)
+{
+	if (proc->runQueue.isNil()) {
+		proc->priority = Smi((int64_t)priority);
+		/* lowering the current process may let a waiting one outrank it */
+		return proc == curProc &&
+		    (readyLevels.smi() >> (priority + 1)) != 0;
+	}
+
+	unlink(proc);
+	proc->priority = Smi((int64_t)priority);
+	return addProcToRunnables(proc);
 }
 
 ProcessOop
 SchedulerOopDesc::getNextForRunning()
 {
-	ProcessOop toRun = runnable;
-	if (!toRun.isNil())
-		removeFromList(runnable, toRun);
+	ProcessOop toRun;
+
+	if (readyLevels.smi() == 0)
+		return ProcessOop::nil();
+
+	toRun = head(63 - __builtin_clzll(readyLevels.smi()));
+	unlink(toRun);
 	return toRun;
 }
 
@@ -128,9 +160,306 @@ void CPUThreadPair::loopAwakeCb(ev::async &w, int revents)
 
 void CPUThreadPair::timeSliceCb(ev::timer &w, int revents)
 {
+	m_sliceExpired = true;
 	m_interruptFlag = true;
 }
 
+ev::tstamp
+CPUThreadPair::quantum()
+{
+	int ms = __atomic_load_n(&s_timeSliceMs, __ATOMIC_RELAXED);
+
+	return ms == 0 ? m_quantum : ms / 1000.;
+}
+
+void
+CPUThreadPair::adaptQuantum()
+{
+	if (m_outrankedInSlice)
+		m_quantum = std::max(m_quantum / 2, kMinQuantum);
+	else if (m_sliceExpired)
+		m_quantum = std::min(m_quantum * 2, kMaxQuantum);
+}
+
+void
+CPUThreadPair::armTimeSlice(bool restart)
+{
+	pthread_mutex_lock(&m_evLock);
+	if (restart || !m_timerArmed) {
+		m_timeSliceTimer.repeat = quantum();
+		m_timeSliceTimer.again();
+		m_loopWake.send();
+		m_timerArmed = true;
+	}
+	pthread_mutex_unlock(&m_evLock);
+}
+
+void
+CPUThreadPair::disarmTimeSlice()
+{
+	pthread_mutex_lock(&m_evLock);
+	if (m_timerArmed) {
+		m_timeSliceTimer.stop();
+		m_loopWake.send();
+		m_timerArmed = false;
+	}
+	pthread_mutex_unlock(&m_evLock);
+}
+
+void
+CPUThreadPair::ioCb(ev::io &w, int revents)
+{
+	w.stop();
+	m_ioReady.push_back(w.fd * 2 + (w.events == ev::WRITE));
+	m_interruptFlag = true;
+	pthread_cond_signal(&m_idleCond);
+}
+
+void
+CPUThreadPair::sleepCb(ev::timer &w, int revents)
+{
+	m_sleepReady.push_back(static_cast<SleepTimer &>(w).slot);
+	m_interruptFlag = true;
+	pthread_cond_signal(&m_idleCond);
+}
+
+void
+CPUThreadPair::timerCb(ev::timer &w, int revents)
+{
+	m_timerReady.push_back(static_cast<SleepTimer &>(w).slot);
+	m_interruptFlag = true;
+	pthread_cond_signal(&m_idleCond);
+}
+
+void
+CPUThreadPair::deliverEvents()
+{
+	std::vector<int> ready;
+	std::vector<size_t> woken;
+	bool timersExpired;
+
+	pthread_mutex_lock(&m_evLock);
+	ready.swap(m_ioReady);
+	woken.swap(m_sleepReady);
+	timersExpired = !m_timerReady.empty();
+	pthread_mutex_unlock(&m_evLock);
+
+	for (int slot : ready) {
+		ProcessOop proc = m_sched->ioWaits->basicAt0(slot)
+		    .as<ProcessOop>();
+
+		/* cancelIO() may have got there first, leaving it empty */
+		m_sched->ioWaits->basicAt0(slot) = Oop::nil();
+		while (!proc.isNil()) {
+			ProcessOop next = proc->link;
+
+			proc->link = ProcessOop::nil();
+			proc->state = Smi((int64_t)1);
+			resume(proc);
+			m_nParked--;
+			proc = next;
+		}
+	}
+
+	for (size_t slot : woken) {
+		ProcessOop proc = m_sched->sleepers->basicAt0(slot)
+		    .as<ProcessOop>();
+
+		m_sched->sleepers->basicAt0(slot) = Oop::nil();
+		m_freeSleepSlots.push_back(slot);
+		proc->state = Smi((int64_t)1);
+		resume(proc);
+		m_nParked--;
+	}
+
+	/* the expired Timers themselves stay queued until it collects them */
+	if (timersExpired && m_timerServiceParked) {
+		m_timerServiceParked = false;
+		m_sched->timerService->state = Smi((int64_t)1);
+		resume(m_sched->timerService);
+	}
+}
+
+void
+CPUThreadPair::growToHold(ArrayOop &array, size_t index)
+{
+	if (index < array->size())
+		return;
+
+	ArrayOop grown = ArrayOopDesc::newWithSize(m_omem,
+	    std::max(index + 1, array->size() * 2));
+
+	for (size_t i = 0; i < array->size(); i++)
+		grown->basicAt0(i) = array->basicAt0(i);
+	array = grown;
+}
+
+void
+CPUThreadPair::awaitIO(ProcessOop proc, int fd, int events)
+{
+	size_t slot = fd * 2 + (events == ev::WRITE);
+	ev::io *watcher;
+
+	growToHold(m_sched->ioWaits, slot);
+	ArrayOop waits = m_sched->ioWaits;
+
+	if (slot >= m_ioWatchers.size())
+		m_ioWatchers.resize(slot + 1);
+	if ((watcher = m_ioWatchers[slot]) == NULL) {
+		watcher = m_ioWatchers[slot] = new ev::io(m_loop);
+		watcher->set<CPUThreadPair, &CPUThreadPair::ioCb>(this);
+	}
+
+	proc->link = waits->basicAt0(slot).as<ProcessOop>();
+	waits->basicAt0(slot) = proc;
+	m_nParked++;
+	proc->state = Smi((int64_t)3);
+
+	/* the first waiter starts the watcher; the others share it */
+	pthread_mutex_lock(&m_evLock);
+	if (!watcher->is_active()) {
+		watcher->start(fd, events);
+		m_loopWake.send();
+	}
+	pthread_mutex_unlock(&m_evLock);
+
+	yield();
+}
+
+template <void (CPUThreadPair::*cb)(ev::timer &, int)>
+size_t
+CPUThreadPair::startSleepTimer(std::vector<SleepTimer *> &timers,
+    std::vector<size_t> &freeSlots, ev::tstamp seconds)
+{
+	SleepTimer *timer;
+	size_t slot;
+
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		timer = timers[slot];
+	} else {
+		slot = timers.size();
+		timer = new SleepTimer(m_loop, slot);
+		timer->set<CPUThreadPair, cb>(this);
+		timers.push_back(timer);
+	}
+
+	/*
+	 * The timer is relative to the loop's cached time, which is stale if
+	 * the loop has slept through a long run with no timeslicer armed.
+	 */
+	pthread_mutex_lock(&m_evLock);
+	ev_now_update(m_loop);
+	timer->set(seconds, 0.);
+	timer->start();
+	m_loopWake.send();
+	pthread_mutex_unlock(&m_evLock);
+
+	return slot;
+}
+
+void
+CPUThreadPair::sleep(ProcessOop proc, ev::tstamp seconds)
+{
+	size_t slot = startSleepTimer<&CPUThreadPair::sleepCb>(m_sleepTimers,
+	    m_freeSleepSlots, seconds);
+
+	growToHold(m_sched->sleepers, slot);
+	m_sched->sleepers->basicAt0(slot) = proc;
+	m_nParked++;
+	proc->state = Smi((int64_t)3);
+
+	yield();
+}
+
+size_t
+CPUThreadPair::startTimer(Oop timer, ev::tstamp seconds)
+{
+	size_t slot = startSleepTimer<&CPUThreadPair::timerCb>(m_timerTimers,
+	    m_freeTimerSlots, seconds);
+
+	growToHold(m_sched->timers, slot);
+	m_sched->timers->basicAt0(slot) = timer;
+	/* an armed Timer keeps the pair running, for it will wake a process */
+	m_nParked++;
+
+	return slot;
+}
+
+bool
+CPUThreadPair::cancelTimer(Oop timer, size_t slot)
+{
+	std::vector<size_t>::iterator expired;
+
+	/* the slot may have been collected, and since reused by another */
+	if (slot >= m_timerTimers.size() ||
+	    m_sched->timers->basicAt0(slot) != timer)
+		return false;
+
+	pthread_mutex_lock(&m_evLock);
+	m_timerTimers[slot]->stop();
+	expired = std::find(m_timerReady.begin(), m_timerReady.end(), slot);
+	if (expired != m_timerReady.end())
+		m_timerReady.erase(expired);
+	m_loopWake.send();
+	pthread_mutex_unlock(&m_evLock);
+
+	m_sched->timers->basicAt0(slot) = Oop::nil();
+	m_freeTimerSlots.push_back(slot);
+	m_nParked--;
+
+	return true;
+}
+
+Oop
+CPUThreadPair::nextExpiredTimer(ProcessOop proc)
+{
+	size_t slot;
+	Oop timer;
+
+	pthread_mutex_lock(&m_evLock);
+	if (m_timerReady.empty()) {
+		pthread_mutex_unlock(&m_evLock);
+		m_sched->timerService = proc;
+		m_timerServiceParked = true;
+		proc->state = Smi((int64_t)3);
+		yield();
+		return Oop::nil();
+	}
+	slot = m_timerReady.front();
+	m_timerReady.erase(m_timerReady.begin());
+	pthread_mutex_unlock(&m_evLock);
+
+	timer = m_sched->timers->basicAt0(slot);
+	m_sched->timers->basicAt0(slot) = Oop::nil();
+	m_freeTimerSlots.push_back(slot);
+	m_nParked--;
+
+	return timer;
+}
+
+void
+CPUThreadPair::cancelIO(int fd)
+{
+	bool cancelled = false;
+
+	pthread_mutex_lock(&m_evLock);
+	for (size_t slot = fd * 2; slot <= fd * 2 + 1; slot++)
+		if (slot < m_ioWatchers.size() && m_ioWatchers[slot] != NULL &&
+		    m_ioWatchers[slot]->is_active()) {
+			m_ioWatchers[slot]->stop();
+			m_ioReady.push_back(slot);
+			cancelled = true;
+		}
+	if (cancelled)
+		m_loopWake.send();
+	pthread_mutex_unlock(&m_evLock);
+
+	if (cancelled)
+		deliverEvents();
+}
+
 void *
 CPUThreadPair::startEvThread(void *arg)
 {
@@ -146,6 +475,23 @@ CPUThreadPair::evLoop()
 	return NULL;
 }
 
+bool
+CPUThreadPair::waitForWork()
+{
+	disarmTimeSlice();
+
+	if (m_nParked == 0)
+		return false;
+
+	pthread_mutex_lock(&m_evLock);
+	while (m_ioReady.empty() && m_sleepReady.empty() &&
+	    m_timerReady.empty())
+		pthread_cond_wait(&m_idleCond, &m_evLock);
+	pthread_mutex_unlock(&m_evLock);
+
+	return true;
+}
+
 void
 CPUThreadPair::scheduleLoop()
 {
@@ -159,8 +505,7 @@ CPUThreadPair::scheduleLoop()
 	if (res != MPS_RES_OK)
 		abort();
 
-	m_sched = m_omem.newOopObj<SchedulerOop>(SchedulerOopDesc::clstNstLength);
-
+	m_sched = SchedulerOopDesc::allocate(m_omem);
 	m_sched.setIsa(cls);
 
 	/** to be moved away */
@@ -170,26 +515,34 @@ CPUThreadPair::scheduleLoop()
 	ProcessOop proc1 = makeProc(m_omem, "doStuff1");
 	m_sched->addProcToRunnables(proc1);
 
-	pthread_mutex_lock(&m_evLock);
-	m_timeSliceTimer.again();
-	m_loopWake.send();
-	std::cout << "Timeslicing starts.\n";
-	pthread_mutex_unlock(&m_evLock);
-
 loop:
+	if (m_nParked != 0)
+		deliverEvents();
+
 	ProcessOop proc = m_sched->getNextForRunning();
-	m_sched->curProc = proc;
+	bool othersRunnable = m_sched->readyLevels.smi() != 0;
 
 	if (proc.isNil()) {
+		if (waitForWork())
+			goto loop;
+
 		std::cout << "All processes finished\n";
-		pthread_mutex_lock(&m_evLock);
-		m_timeSliceTimer.stop();
-		m_loopWake.send();
-		std::cout << "Timeslicing stops.\n";
-		pthread_mutex_unlock(&m_evLock);
 		return;
 	}
 
+	m_sched->curProc = proc;
+
+	/*
+	 * A lone runnable process needs no timeslicer; resume() arms it should
+	 * another process become runnable meanwhile.
+	 */
+	m_sliceExpired = false;
+	m_outrankedInSlice = false;
+	if (othersRunnable)
+		armTimeSlice();
+	else
+		disarmTimeSlice();
+
 	std::cout <<"\nRunning "  << proc->name->asCStr() << ":\n";
 
 	if (execute(m_omem, proc, m_interruptFlag) == 0) {
@@ -204,6 +557,10 @@ loop:
 		m_sched->addProcToRunnables(proc);
 	}
 
+	if (__atomic_load_n(&s_timeSliceMs, __ATOMIC_RELAXED) == 0)
+		adaptQuantum();
+
+	m_sched->curProc = ProcessOop::nil();
 	m_interruptFlag = false;
 	goto loop;
 }
@@ -241,26 +598,67 @@ CPUThreadPair::yield()
 	interrupt();
 }
 
+void
+CPUThreadPair::preempt()
+{
+	interrupt();
+}
+
+void
+CPUThreadPair::resume(ProcessOop proc)
+{
+	if (!proc->runQueue.isNil())
+		return;
+
+	if (m_sched->addProcToRunnables(proc)) {
+		m_outrankedInSlice = true;
+		preempt();
+	} else if (!m_sched->curProc.isNil())
+		armTimeSlice(false);
+}
+
+void
+CPUThreadPair::suspend(ProcessOop proc)
+{
+	if (!proc->runQueue.isNil())
+		m_sched->suspendProcess(proc);
+}
+
+void
+CPUThreadPair::setPriority(ProcessOop proc, int priority)
+{
+	if (m_sched->setPriority(proc, priority))
+		preempt();
+}
+
+int
+CPUThreadPair::setTimeSlice(int ms)
+{
+	return __atomic_exchange_n(&s_timeSliceMs, ms, __ATOMIC_RELAXED);
+}
+
 CPUThreadPair *
 CPUThreadPair::curpair()
 {
 	return g_curpair;
 }
 
-CPUThreadPair::CPUThreadPair(ObjectMemory &omem, void * stackMarker)
-    : m_omem(omem), m_loop(ev::default_loop()), m_loopWake(m_loop), m_timeSliceTimer(m_loop)
+CPUThreadPair::CPUThreadPair(ObjectMemory &omem, void *stackMarker)
+    : m_omem(omem), m_loop(ev::default_loop()), m_loopWake(m_loop),
+    m_timeSliceTimer(m_loop)
 {
 	int r;
 
 	m_interpThread = pthread_self();
 	g_curpair = this;
 	pthread_mutex_init(&m_evLock, 0);
+	pthread_cond_init(&m_idleCond, 0);
 
 	ev_set_userdata(m_loop, this);
 	ev_set_loop_release_cb(m_loop, loopRelease, loopAcquire);
 	m_loopWake.set<CPUThreadPair, &CPUThreadPair::loopAwakeCb> (this);
 	m_loopWake.start();
-	m_timeSliceTimer.set(0., 0.1);
+	m_timeSliceTimer.set(0., quantum());
 	m_timeSliceTimer.set<CPUThreadPair, &CPUThreadPair::timeSliceCb>(this);
 
 	mps_res_t res = mps_thread_reg(&m_interpMps, omem.m_arena);
@@ -284,6 +682,12 @@ CPUThreadPair::CPUThreadPair(ObjectMemory &omem, void * stackMarker)
 	pthread_mutex_unlock(&m_evLock);
 
 	pthread_join(m_evThread, NULL);
+	for (ev::io *watcher : m_ioWatchers)
+		delete watcher;
+	for (SleepTimer *timer : m_sleepTimers)
+		delete timer;
+	for (SleepTimer *timer : m_timerTimers)
+		delete timer;
 
 	std::cout << "CPU thread exiting.\n";
-}
\ No newline at end of file
+}
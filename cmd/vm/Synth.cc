@@ -59,6 +59,61 @@ AbstractCodeScope::addLocal(std::string name)
 	locals.push_back(new LocalVar(locals.size() + 1, name));
 }
 
+/**
+ * Returns whether an inlined block's argument named \p name can be bound here:
+ * it must neither shadow a real local or argument, nor be bound already.
+ */
+bool
+AbstractCodeScope::mayClaimInlinedArg(std::string name)
+{
+	for (auto &a : inlinedArgs)
+		if (a.second == name)
+			return a.first->name.empty();
+
+	for (auto v : locals)
+		if (v->name == name)
+			return false;
+	for (auto v : args)
+		if (v->name == name)
+			return false;
+	return true;
+}
+
+/**
+ * Binds \p name to a local standing in for an inlined block's argument, till
+ * released with releaseInlinedArg(). Returns NULL if it may not be claimed.
+ */
+LocalVar *
+AbstractCodeScope::claimInlinedArg(std::string name)
+{
+	if (!mayClaimInlinedArg(name))
+		return NULL;
+
+	for (auto &a : inlinedArgs)
+		if (a.second == name) {
+			a.first->name = name;
+			return a.first;
+		}
+
+	addLocal(name);
+	inlinedArgs.push_back({ locals.back(), name });
+	return locals.back();
+}
+
+/**
+ * Unbinds the name of the inlined argument \p var, and of any heapvar it was
+ * promoted to, once the inlined block is done with. The local keeps its slot
+ * for reuse.
+ */
+void
+AbstractCodeScope::releaseInlinedArg(LocalVar *var)
+{
+	var->name.clear();
+	for (auto &v : myHeapVars)
+		if (v.second == var)
+			v.first->name.clear();
+}
+
 ParentsHeapVar *
 AbstractCodeScope::promote(Var *aNode)
 {
@@ -69,6 +124,52 @@ AbstractCodeScope::promote(Var *aNode)
 	return new ParentsHeapVar(myHeapVars.size(), aNode->name);
 }
 
+bool
+AbstractCodeScope::noteAssignment(std::string aName, bool fromBlock)
+{
+	Var *var = NULL;
+
+	for (auto v : locals)
+		if (v->name == aName)
+			var = v;
+	for (auto v : args)
+		if (v->name == aName)
+			var = v;
+
+	if (var == NULL)
+		return false;
+
+	/*
+	 * Assignments are noted in textual order, which is execution order but
+	 * for loops; so an assignment within one is assumed to follow capture.
+	 */
+	if (fromBlock || var->promoted || loopDepth > 0)
+		var->assignedAfterCapture = true;
+	return true;
+}
+
+void
+AbstractCodeScope::decideCapturesByCopy()
+{
+	if (myHeapVars.empty())
+		return;
+
+	for (auto &v : myHeapVars)
+		if (v.second->kind == Var::kParentsHeapVar ||
+		    v.second->assignedAfterCapture) {
+			/* one shared local would serve every binding */
+			for (auto send : capturingInlines)
+				send->m_mayInline = false;
+			if (!capturingInlines.empty())
+				methodScope()->mustResynthesise = true;
+			return;
+		}
+
+	capturesByCopy = true;
+	for (auto &v : myHeapVars)
+		v.second->promoted = false;
+}
+
 Var *
 MethodScope::lookup(std::string aName)
 {
@@ -110,7 +211,13 @@ BlockScope::lookup(std::string aName)
 	for (auto v : locals)
 		if (v->name == aName)
 			return v;
-	return parent()->lookupFromBlock(aName);
+
+	candidate = parent()->lookupFromBlock(aName);
+	if (candidate->kind == Var::kParentsHeapVar) {
+		isClean = false;
+		usesParentHeapVars = true;
+	}
+	return candidate;
 }
 
 Var *
@@ -131,16 +238,33 @@ BlockScope::lookupFromBlock(std::string aName)
 
 	par = parent()->lookupFromBlock(aName);
 
-	if ((parCand = dynamic_cast<ParentsHeapVar *>(par)))
+	if ((parCand = dynamic_cast<ParentsHeapVar *>(par))) {
 		/*
 		 * Parent has a heapvar for it, but we don't have a local
 		 * reference! Therefore let us create a local copy in our own
 		 * heapvars.
 		 */
+		isClean = false;
+		usesParentHeapVars = true;
 		return promote(par);
+	}
 	return par;
 }
 
+void
+BlockScope::noteUsesHome()
+{
+	isClean = false;
+	parent()->noteUsesHome();
+}
+
+bool
+BlockScope::noteAssignment(std::string aName, bool fromBlock)
+{
+	return AbstractCodeScope::noteAssignment(aName, fromBlock) ||
+	    parent()->noteAssignment(aName, true);
+}
+
 #pragma expressions
 
 void
@@ -149,6 +273,10 @@ PrimitiveExprNode::synthInScope(Scope *scope)
 	num = Primitive::named(name.c_str());
 	if (num == NULL)
 		throw std::runtime_error("Unknown primitive " + name);
+	if (num->kind != Primitive::kVariadic && args.size() != num->kind)
+		throw std::runtime_error("Primitive " + name + " expects " +
+		    std::to_string(num->kind) + " arguments, given " +
+		    std::to_string(args.size()));
 
 	for (auto arg : args)
 		arg->synthInScope(scope);
@@ -158,6 +286,11 @@ void
 IdentExprNode::synthInScope(Scope *scope)
 {
 	var = scope->lookup(id);
+	if (var == NULL)
+		throw std::runtime_error("Undeclared identifier " + id);
+	if (isSelf() || isSuper() || id == "thisContext" ||
+	    var->kind == Var::kInstance)
+		scope->noteUsesHome();
 }
 
 void
@@ -165,9 +298,20 @@ AssignExprNode::synthInScope(Scope *scope)
 {
 	left->synthInScope(scope);
 	right->synthInScope(scope);
+	/* noted after the right side, which may capture before we assign */
+	scope->noteAssignment(left->id);
 }
 
-static int
+/**
+ * Adjusts the depth of inlined loops within the code scope \p scope.
+ */
+static void
+adjustLoopDepth(Scope *scope, int by)
+{
+	dynamic_cast<AbstractCodeScope *>(scope)->loopDepth += by;
+}
+
+int
 isOptimisedBinop(std::string sel)
 {
 	for (int i = 0; i < sizeof(ObjectMemory::binOpStr) /
@@ -177,17 +321,185 @@ isOptimisedBinop(std::string sel)
 	return -1;
 }
 
+/**
+ * Returns \p node if it is a literal block taking \p nArgs arguments and
+ * declaring no locals, which may therefore be inlined with its arguments bound
+ * to locals of the enclosing scope; otherwise returns NULL.
+ */
+static BlockExprNode *
+inlinableBlock(ExprNode *node, size_t nArgs)
+{
+	BlockExprNode *block = dynamic_cast<BlockExprNode *>(node);
+
+	if (block == NULL || block->args.size() != nArgs ||
+	    !block->locals.empty())
+		return NULL;
+	return block;
+}
+
+/**
+ * Synthesises #to:do:, #to:by:do:, and #do: sent to the result of #to: or
+ * #to:by:, as an inlined counting loop, if the body is a suitable block and
+ * any step is a nonzero integer literal (so that the direction is known.)
+ * Returns false, having done nothing, if not.
+ */
+bool
+MessageExprNode::synthCountingLoopInScope(Scope *scope)
+{
+	auto codeScope = dynamic_cast<AbstractCodeScope *>(scope);
+	MessageExprNode *interval;
+	ExprNode *from, *to, *step = NULL;
+	IntExprNode *stepLit;
+
+	if (selector == "to:do:" || selector == "to:by:do:") {
+		from = receiver;
+		to = args[0];
+		if (args.size() == 3)
+			step = args[1];
+	} else if (selector == "do:" &&
+	    (interval = dynamic_cast<MessageExprNode *>(receiver)) &&
+	    (interval->selector == "to:" || interval->selector == "to:by:")) {
+		from = interval->receiver;
+		to = interval->args[0];
+		if (interval->args.size() == 2)
+			step = interval->args[1];
+	} else
+		return false;
+
+	if (!m_mayInline)
+		return false;
+
+	if (step) {
+		stepLit = dynamic_cast<IntExprNode *>(step);
+		if (stepLit == NULL || stepLit->num == 0)
+			return false;
+		m_step = stepLit->num;
+	}
+
+	if ((m_body = inlinableBlock(args.back(), 1)) == NULL ||
+	    !codeScope->mayClaimInlinedArg(m_body->args[0].first)) {
+		m_body = NULL;
+		return false;
+	}
+
+	m_specialKind = kToDo;
+	m_from = from;
+	m_to = to;
+	/* evaluated outside the loop, so they cannot see its counter */
+	from->synthInScope(scope);
+	to->synthInScope(scope);
+	m_blockArg = codeScope->claimInlinedArg(m_body->args[0].first);
+	assert(m_blockArg != NULL);
+	/*
+	 * The loop's own stepping of the counter is not noted as an assignment:
+	 * each iteration stands for a fresh activation of the block, so a block
+	 * capturing the counter by copy sees the value of its own iteration.
+	 * Captured otherwise, it would be shared by all; see
+	 * decideCapturesByCopy().
+	 */
+	adjustLoopDepth(scope, 1);
+	m_body->synthInlineInScope(scope);
+	adjustLoopDepth(scope, -1);
+	if (m_blockArg->promoted)
+		codeScope->capturingInlines.push_back(this);
+	codeScope->releaseInlinedArg(m_blockArg);
+
+	return true;
+}
+
+/**
+ * Synthesises #isNil, #notNil, and the #ifNil: family, if their arguments are
+ * suitable blocks. Returns false, having done nothing, if not.
+ */
+bool
+MessageExprNode::synthNilTestInScope(Scope *scope)
+{
+	auto codeScope = dynamic_cast<AbstractCodeScope *>(scope);
+	ExprNode *nilBlock = NULL, *notNilBlock = NULL;
+
+	if (selector == "isNil")
+		m_specialKind = kIsNil;
+	else if (selector == "notNil")
+		m_specialKind = kNotNil;
+	else if (selector == "ifNil:") {
+		m_specialKind = kIfNil;
+		nilBlock = args[0];
+	} else if (selector == "ifNotNil:") {
+		m_specialKind = kIfNotNil;
+		notNilBlock = args[0];
+	} else if (selector == "ifNil:ifNotNil:") {
+		m_specialKind = kIfNilIfNotNil;
+		nilBlock = args[0];
+		notNilBlock = args[1];
+	} else if (selector == "ifNotNil:ifNil:") {
+		m_specialKind = kIfNotNilIfNil;
+		notNilBlock = args[0];
+		nilBlock = args[1];
+	} else
+		return false;
+
+	/* the ifNotNil: block may take the receiver as its argument */
+	if ((nilBlock && !inlinableBlock(nilBlock, 0)) || (notNilBlock &&
+	    !inlinableBlock(notNilBlock, 0) && !inlinableBlock(notNilBlock, 1)))
+		goto fail;
+
+	if (notNilBlock && (m_body = inlinableBlock(notNilBlock, 1)) &&
+	    (!m_mayInline ||
+	    !codeScope->mayClaimInlinedArg(m_body->args[0].first)))
+		goto fail;
+
+	receiver->synthInScope(scope);
+	if (m_body) {
+		m_blockArg = codeScope->claimInlinedArg(m_body->args[0].first);
+		assert(m_blockArg != NULL);
+	}
+	for (auto arg : args)
+		arg->synthInlineInScope(scope);
+	if (m_blockArg) {
+		if (m_blockArg->promoted)
+			codeScope->capturingInlines.push_back(this);
+		codeScope->releaseInlinedArg(m_blockArg);
+	}
+
+	return true;
+
+fail:
+	m_specialKind = kNormal;
+	m_body = NULL;
+	return false;
+}
+
 void
 MessageExprNode::synthInScope(Scope *scope)
 {
+	/* as the method may be synthesised more than once */
+	m_specialKind = kNormal;
+	m_body = NULL;
+	m_blockArg = NULL;
+
 	if (receiver->isSuper())
 		goto plain;
 
+	if (synthCountingLoopInScope(scope) || synthNilTestInScope(scope))
+		return;
+
 	if (selector == "and:") {
 		receiver->synthInScope(scope);
 		m_specialKind = kAnd;
 		args[0]->synthInlineInScope(scope);
 		return;
+	} else if (selector == "or:") {
+		receiver->synthInScope(scope);
+		m_specialKind = kOr;
+		args[0]->synthInlineInScope(scope);
+		return;
+	} else if (selector == "timesRepeat:" && inlinableBlock(args[0], 0)) {
+		receiver->synthInScope(scope);
+		m_specialKind = kTimesRepeat;
+		adjustLoopDepth(scope, 1);
+		args[0]->synthInlineInScope(scope);
+		adjustLoopDepth(scope, -1);
+		return;
 	} else if (selector == "ifTrue:ifFalse:") {
 		receiver->synthInScope(scope);
 		m_specialKind = kIfTrueIfFalse;
@@ -211,23 +523,35 @@ MessageExprNode::synthInScope(Scope *scope)
 		args[0]->synthInlineInScope(scope);
 		return;
 	} else if (selector == "whileTrue") {
+		adjustLoopDepth(scope, 1);
 		receiver->synthInlineInScope(scope);
+		adjustLoopDepth(scope, -1);
 		m_specialKind = kWhileTrue0;
 		return;
 	} else if (selector == "whileFalse") {
+		adjustLoopDepth(scope, 1);
 		receiver->synthInlineInScope(scope);
+		adjustLoopDepth(scope, -1);
 		m_specialKind = kWhileFalse0;
 		return;
 	} else if (selector == "whileTrue:") {
+		adjustLoopDepth(scope, 1);
 		receiver->synthInlineInScope(scope);
 		m_specialKind = kWhileTrue;
 		args[0]->synthInlineInScope(scope);
+		adjustLoopDepth(scope, -1);
 		return;
 	} else if (selector == "whileFalse:") {
+		adjustLoopDepth(scope, 1);
 		receiver->synthInlineInScope(scope);
 		m_specialKind = kWhileFalse;
 		args[0]->synthInlineInScope(scope);
+		adjustLoopDepth(scope, -1);
 		return;
+	} else if (selector == "==") {
+		m_specialKind = kIdentEq;
+	} else if (selector == "class") {
+		m_specialKind = kClassOf;
 	} else {
 		int binOp = isOptimisedBinop(selector);
 
@@ -254,6 +578,7 @@ void
 BlockExprNode::synthInScope(Scope *parentScope)
 {
 	scope = new BlockScope(dynamic_cast<AbstractCodeScope *>(parentScope));
+	m_inlined = false;
 
 	for (auto & arg : args)
 		scope->addArg(arg.first);
@@ -263,6 +588,8 @@ BlockExprNode::synthInScope(Scope *parentScope)
 
 	for (auto stmt : stmts)
 		stmt->synthInScope(scope);
+
+	scope->decideCapturesByCopy();
 }
 
 void
@@ -270,7 +597,7 @@ BlockExprNode::synthInlineInScope(Scope *parentScope)
 {
 	auto parentCodeScope = dynamic_cast<AbstractCodeScope*>(parentScope);
 
-	assert(args.empty());
+	/* any arguments were bound to locals of the parent by the inliner */
 	assert(parentCodeScope != NULL);
 
 	m_inlined = true;
@@ -305,6 +632,8 @@ void
 ReturnStmtNode::synthInScope(Scope *scope)
 {
 	expr->synthInScope(scope);
+	/* within a block, this is a block return */
+	scope->noteUsesHome();
 }
 
 #pragma decls
@@ -314,14 +643,18 @@ MethodNode::synthInClassScope(ClassScope *clsScope)
 {
 	/* We expect to get a class node already set up with its ivars etc. If
 	 * not, no problem. */
-	scope = new MethodScope(clsScope);
-
-	for (auto & arg : args)
-		scope->addArg(arg.first);
-	for (auto & local : locals)
-		scope->addLocal(local.first);
-	for (auto stmt : stmts)
-		stmt->synthInScope(scope);
+	do {
+		scope = new MethodScope(clsScope);
+
+		for (auto & arg : args)
+			scope->addArg(arg.first);
+		for (auto & local : locals)
+			scope->addLocal(local.first);
+		for (auto stmt : stmts)
+			stmt->synthInScope(scope);
+
+		scope->decideCapturesByCopy();
+	} while (scope->mustResynthesise);
 
 	return this;
 }
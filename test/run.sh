@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Runs a test program under the VM and fails unless every check it prints
+# is 'ok' and all its processes finish within the time limit.
+#
+# usage: run.sh path/to/valutron path/to/test.st
+#
+
+if [ $# -ne 2 ]; then
+	echo "usage: $0 valutron file.st" >&2
+	exit 2
+fi
+
+vm=$1
+prog=$2
+tmp=$(mktemp) || exit 2
+trap 'rm -f "$tmp"' EXIT
+timeout 120 "$vm" "$prog" >"$tmp" 2>/dev/null
+status=$?
+out=$(tr -d '\0' <"$tmp")
+
+printf '%s\n' "$out" | grep -e '^ok' -e '^not ok'
+
+if [ $status -ne 0 ]; then
+	echo "$prog: exited with status $status" >&2
+	exit 1
+elif printf '%s\n' "$out" | grep -q '^not ok'; then
+	echo "$prog: some checks failed" >&2
+	exit 1
+elif ! printf '%s\n' "$out" | grep -q '^ok'; then
+	echo "$prog: no checks ran" >&2
+	exit 1
+elif ! printf '%s\n' "$out" | grep -q '^All processes finished'; then
+	echo "$prog: did not finish" >&2
+	exit 1
+fi